@@ -0,0 +1,326 @@
+#ifndef _BROADPHASE_HPP
+#define _BROADPHASE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// An entity's box as the broadphase knows it, with a category bit for
+// queries to pick it by, and an owner tag. Entities with the same owner never
+// pair up.
+struct BroadEntity {
+    static constexpr uint32_t no_owner = UINT32_MAX;
+
+    uint32_t id;
+    uint32_t category = 0;
+    uint32_t owner = no_owner;
+    float x;
+    float y;
+    float width;
+    float height;
+};
+
+// A rectangular query region. Only entities in one of the categories in
+// mask are reported, and none owned by exclude_owner.
+struct BroadQuery {
+    float x;
+    float y;
+    float width;
+    float height;
+    uint32_t mask = UINT32_MAX;
+    uint32_t exclude_owner = BroadEntity::no_owner;
+};
+
+// Uniform grid over the arena. An entity is kept in every cell its box
+// touches, and a query reports it once, from the cell holding the top-left
+// corner of where the entity and the query overlap, so nothing has to be
+// deduplicated afterwards. Boxes outside the grid are clamped into its edge
+// cells. Queries may run concurrently with each other, but not with anything
+// that changes the grid.
+//
+// Ids are expected to be dense indices in their low index_bits bits, so each
+// entity's record is found by indexing an array rather than hashing. The rest
+// of the id tells a stale id apart from whatever reuses its index.
+class BroadSolver {
+public:
+    BroadSolver(unsigned int width, unsigned int height, unsigned int index_bits, unsigned int cell_size = 256) :
+        cell_size(cell_size),
+        index_mask((1u << index_bits) - 1) {
+        resize(width, height);
+    }
+
+    void insert(const BroadEntity& entity) {
+        remove(entity.id);
+        size_t index = entity.id & index_mask;
+        if (index >= records.size()) {
+            records.resize(index + 1);
+        }
+        Record& record = records[index];
+        record.entity = entity;
+        record.range = range_of(entity.x, entity.y, entity.width, entity.height);
+        record.live = true;
+        live_records++;
+        add(record);
+    }
+
+    // Inserts count entities at once
+    void insert(const BroadEntity* entities, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            insert(entities[i]);
+        }
+    }
+
+    // Returns false if there is no entity with id
+    bool remove(uint32_t id) {
+        Record* record = find_record(id);
+        if (!record) {
+            return false;
+        }
+        take(*record);
+        record->live = false;
+        live_records--;
+        return true;
+    }
+
+    // Replaces the box of the entity with the same id
+    void mutate(const BroadEntity& entity) {
+        Record* found = find_record(entity.id);
+        if (!found) {
+            return;
+        }
+        Record& record = *found;
+        record.entity = entity;
+
+        Range range = range_of(entity.x, entity.y, entity.width, entity.height);
+        if (range == record.range) {
+            for (unsigned int y = range.y0; y <= range.y1; y++) {
+                for (unsigned int x = range.x0; x <= range.x1; x++) {
+                    *find(cells[y * columns + x], entity.id) = entity;
+                }
+            }
+        } else {
+            take(record);
+            record.range = range;
+            add(record);
+        }
+    }
+
+    // Replaces the boxes of count entities at once, such as everything that
+    // moved this tick. When most of the grid moved it's cheaper to refill
+    // every cell than to patch entries in place, so that's done instead.
+    void update(const BroadEntity* entities, size_t count) {
+        if (count * 2 < live_records) {
+            for (size_t i = 0; i < count; i++) {
+                mutate(entities[i]);
+            }
+            return;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (Record* record = find_record(entities[i].id)) {
+                record->entity = entities[i];
+                record->range = range_of(entities[i].x, entities[i].y, entities[i].width, entities[i].height);
+            }
+        }
+        for (auto& cell : cells) {
+            cell.clear();
+        }
+        for (const auto& record : records) {
+            if (record.live) {
+                add(record);
+            }
+        }
+    }
+
+    void clear() {
+        for (auto& cell : cells) {
+            cell.clear();
+        }
+        records.clear();
+        live_records = 0;
+    }
+
+    // Regrids everything when the grid needs more or fewer cells to cover
+    // width by height
+    void resize(unsigned int width, unsigned int height) {
+        unsigned int new_columns = std::max((width + cell_size - 1) / cell_size, 1u);
+        unsigned int new_rows = std::max((height + cell_size - 1) / cell_size, 1u);
+        if (new_columns == columns && new_rows == rows) {
+            return;
+        }
+
+        columns = new_columns;
+        rows = new_rows;
+        cells.clear();
+        cells.resize(columns * rows);
+        for (auto& record : records) {
+            if (record.live) {
+                record.range = range_of(record.entity.x, record.entity.y, record.entity.width, record.entity.height);
+                add(record);
+            }
+        }
+    }
+
+    size_t size() const {
+        return live_records;
+    }
+
+    size_t memory_usage() const {
+        size_t usage = sizeof(*this) + cells.capacity() * sizeof(Cell) + records.capacity() * sizeof(Record);
+        for (const auto& cell : cells) {
+            usage += cell.capacity() * sizeof(BroadEntity);
+        }
+        return usage;
+    }
+
+    // Calls visitor with every entity whose box overlaps query and that
+    // query's filter lets through, straight out of the grid, so nothing is
+    // copied or allocated. The grid must not be changed from inside visitor.
+    template <typename Visitor>
+    void visit(const BroadQuery& query, Visitor&& visitor) const {
+        Range range = range_of(query.x, query.y, query.width, query.height);
+        for (unsigned int y = range.y0; y <= range.y1; y++) {
+            for (unsigned int x = range.x0; x <= range.x1; x++) {
+                for (const BroadEntity& entity : cells[y * columns + x]) {
+                    if ((entity.category & query.mask) &&
+                        (query.exclude_owner == BroadEntity::no_owner || entity.owner != query.exclude_owner) &&
+                        overlaps(entity, query) &&
+                        x == std::max(column_of(entity.x), range.x0) &&
+                        y == std::max(row_of(entity.y), range.y0)) {
+                        visitor(entity);
+                    }
+                }
+            }
+        }
+    }
+
+    // Calls visitor with every pair of entities whose boxes overlap and whose
+    // owners differ, once per pair, in one pass over the grid. A pair is
+    // reported from the cell holding the top-left corner of where the two
+    // overlap. The grid must not be changed from inside visitor.
+    template <typename Visitor>
+    void visit_pairs(Visitor&& visitor) const {
+        for (unsigned int y = 0; y < rows; y++) {
+            for (unsigned int x = 0; x < columns; x++) {
+                const Cell& cell = cells[y * columns + x];
+                for (size_t i = 0; i < cell.size(); i++) {
+                    for (size_t j = i + 1; j < cell.size(); j++) {
+                        const BroadEntity& a = cell[i];
+                        const BroadEntity& b = cell[j];
+                        if ((a.owner == BroadEntity::no_owner || a.owner != b.owner) &&
+                            overlaps(a, b) &&
+                            x == std::max(column_of(a.x), column_of(b.x)) &&
+                            y == std::max(row_of(a.y), row_of(b.y))) {
+                            visitor(a, b);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Copies the entities whose boxes overlap query into dst, up to capacity
+    // of them. Returns how many overlap in all, so a result larger than
+    // capacity means dst was truncated.
+    size_t solve(const BroadQuery& query, BroadEntity* dst, size_t capacity) const {
+        size_t len = 0;
+        visit(query, [&](const BroadEntity& entity) {
+            if (len < capacity) {
+                dst[len] = entity;
+            }
+            len++;
+        });
+        return len;
+    }
+
+private:
+    using Cell = std::vector<BroadEntity>;
+
+    // Cells covered by a box, inclusive
+    struct Range {
+        unsigned int x0, y0, x1, y1;
+
+        bool operator==(const Range& other) const {
+            return x0 == other.x0 && y0 == other.y0 && x1 == other.x1 && y1 == other.y1;
+        }
+    };
+
+    struct Record {
+        BroadEntity entity;
+        Range range;
+        bool live = false;
+    };
+
+    unsigned int cell_size;
+    uint32_t index_mask;
+    unsigned int columns = 0;
+    unsigned int rows = 0;
+    std::vector<Cell> cells;     // row by row
+    std::vector<Record> records; // by id index
+    size_t live_records = 0;
+
+    // Returns nullptr if there is no entity with id
+    Record* find_record(uint32_t id) {
+        size_t index = id & index_mask;
+        if (index >= records.size() || !records[index].live || records[index].entity.id != id) {
+            return nullptr;
+        }
+        return &records[index];
+    }
+
+    template <typename Box>
+    static bool overlaps(const BroadEntity& entity, const Box& box) {
+        return entity.x < box.x + box.width &&
+               entity.x + entity.width > box.x &&
+               entity.y < box.y + box.height &&
+               entity.y + entity.height > box.y;
+    }
+
+    static unsigned int cell_of(float coordinate, unsigned int cell_size, unsigned int count) {
+        float cell = std::floor(coordinate / cell_size);
+        if (!(cell > 0)) {
+            return 0;
+        }
+        return std::min((unsigned int) cell, count - 1);
+    }
+
+    unsigned int column_of(float x) const {
+        return cell_of(x, cell_size, columns);
+    }
+
+    unsigned int row_of(float y) const {
+        return cell_of(y, cell_size, rows);
+    }
+
+    Range range_of(float x, float y, float width, float height) const {
+        return Range {column_of(x), row_of(y), column_of(x + width), row_of(y + height)};
+    }
+
+    static Cell::iterator find(Cell& cell, uint32_t id) {
+        return std::find_if(cell.begin(), cell.end(), [id](const BroadEntity& entity) {
+            return entity.id == id;
+        });
+    }
+
+    void add(const Record& record) {
+        for (unsigned int y = record.range.y0; y <= record.range.y1; y++) {
+            for (unsigned int x = record.range.x0; x <= record.range.x1; x++) {
+                cells[y * columns + x].push_back(record.entity);
+            }
+        }
+    }
+
+    void take(const Record& record) {
+        for (unsigned int y = record.range.y0; y <= record.range.y1; y++) {
+            for (unsigned int x = record.range.x0; x <= record.range.x1; x++) {
+                Cell& cell = cells[y * columns + x];
+                *find(cell, record.entity.id) = cell.back();
+                cell.pop_back();
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef _COMPRESSOR_HPP
+#define _COMPRESSOR_HPP
+
+#include "streampeerbuffer.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <zstd.h>
+
+// zstd compression for outbound packets, optionally primed with a dictionary
+// trained on recorded census traffic (see README). Not thread-safe.
+class Compressor {
+public:
+    std::string dictionary; // raw bytes, served to clients at /census.dict
+
+    Compressor(int level = 3) :
+        level(level),
+        cctx(ZSTD_createCCtx()) {
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+    }
+
+    ~Compressor() {
+        ZSTD_freeCCtx(cctx);
+        if (cdict) ZSTD_freeCDict(cdict);
+    }
+
+    Compressor(const Compressor&) = delete;
+    Compressor& operator=(const Compressor&) = delete;
+
+    int load_dictionary(const std::string& filename) {
+        std::ifstream dictionary_file(filename, std::ios::binary);
+        if (!dictionary_file.is_open()) {
+            perror(std::string("Failed to open " + filename).c_str());
+            return -1;
+        }
+        std::string data((std::istreambuf_iterator<char>(dictionary_file)),
+            std::istreambuf_iterator<char>());
+
+        ZSTD_CDict* new_cdict = ZSTD_createCDict(data.data(), data.size(), level);
+        if (!new_cdict) {
+            return -1;
+        }
+        ZSTD_CCtx_refCDict(cctx, new_cdict);
+        if (cdict) ZSTD_freeCDict(cdict);
+        cdict = new_cdict;
+        dictionary = std::move(data);
+        return 0;
+    }
+
+    // 0 when compressing without a dictionary
+    unsigned dictionary_id() {
+        return cdict ? ZSTD_getDictID_fromCDict(cdict) : 0;
+    }
+
+    // Appends one zstd frame holding the segments, back to back, to dst,
+    // whose offset must be at its end. The segments are streamed into the
+    // frame as they are, without being gathered first. Returns 0 on success.
+    int compress(const spb::Segment* segments, size_t count, spb::StreamPeerBuffer& dst) {
+        size_t len = 0;
+        for (size_t i = 0; i < count; i++) {
+            len += segments[i].size;
+        }
+
+        ZSTD_CCtx_reset(cctx, ZSTD_reset_session_only);
+        ZSTD_CCtx_setPledgedSrcSize(cctx, len);
+
+        size_t start = dst.offset;
+        ZSTD_outBuffer out = {dst.skip(ZSTD_compressBound(len)), ZSTD_compressBound(len), 0};
+        for (size_t i = 0; i < count; i++) {
+            ZSTD_inBuffer in = {segments[i].data, segments[i].size, 0};
+            while (in.pos != in.size) {
+                if (ZSTD_isError(ZSTD_compressStream2(cctx, &out, &in, ZSTD_e_continue))) {
+                    dst.offset = start;
+                    dst.resize(start);
+                    return 1;
+                }
+            }
+        }
+        ZSTD_inBuffer end = {nullptr, 0, 0};
+        size_t remaining;
+        do {
+            remaining = ZSTD_compressStream2(cctx, &out, &end, ZSTD_e_end);
+            if (ZSTD_isError(remaining)) {
+                dst.offset = start;
+                dst.resize(start);
+                return 1;
+            }
+        } while (remaining != 0);
+
+        dst.offset = start + out.pos;
+        dst.resize(dst.offset);
+        return 0;
+    }
+
+private:
+    int level;
+    ZSTD_CCtx* cctx;
+    ZSTD_CDict* cdict = nullptr;
+};
+
+#endif
@@ -1,20 +1,33 @@
 #pragma once
 // #define THREADING
 // #define DEBUG_MAINLOOP_SPEED
+// #define DEBUG_POOLS
 #define COLLISION_STRENGTH     5
 #define BOT_ACCURACY_THRESHOLD 30
 #define TARGET_TPS             30
 #define DELTA_TPS              30
 #define RAND(a, b)             rand() % (b - a + 1) + a
 #define ELLIPSIS               "…"
+#define COMPRESSION_MIN_SIZE   64
+#define SLEEP_VELOCITY         0.05f
+#define SLEEP_TICKS            15
+#define FAT_MARGIN             10.f // room around a box in the broadphase
+#define FAT_TICKS              4.f  // ticks of motion a box has room for
 
 #include "bcblog.hpp"
+#include "broadphase.hpp"
+#include "compressor.hpp"
 #include "entityconfig.hpp"
-#include "fazo.h"
+#include "objectpool.hpp"
+#include "packets.hpp"
 #include "streampeerbuffer.hpp"
 #include "ws28/src/Server.h"
 #include <chrono>
+#include <array>
+#include <climits>
 #include <cmath>
+#include <cstdlib>
+#include <deque>
 #include <iostream>
 #include <leveldb/db.h>
 #include <map>
@@ -39,46 +52,22 @@ typedef std::unordered_map<std::string, std::string> HTTPHeaders;
 
 leveldb::DB* db;          // NOLINT
 leveldb::Options options; // NOLINT
+Compressor compressor;    // NOLINT
 #ifdef THREADING
 tp::ThreadPool pool; // NOLINT
 #endif
 
-enum class Packet : unsigned char {
-    InboundInit = 0,
-    Input = 1,
-    Census = 2,
-    OutboundInit = 3,
-    Mockups = 3,
-    Chat = 4,
-    Death = 5,
-    Respawn = 6,
-    Leaderboard = 7
-};
-
 struct ClientInfo {
     string path;
     HTTPHeaders headers;
     unsigned int id;
     bool authenticated = false;
-};
-
-unsigned uid = 0; // NOLINT
+    uint8_t capabilities = 0;
 
-inline unsigned int get_uid() {
-    if (uid > UINT32_MAX - 10000) {
-        WARN("IDs are close to the 32-bit unsigned integer limit");
+    bool has(Capability capability) {
+        return capabilities & (uint8_t) capability;
     }
-    return uid++;
-}
-
-template <class A, class B>
-inline bool aabb(const A& rect1, const B& rect2) {
-    return (
-        rect1.x < rect2.x + rect2.width &&
-        rect1.x + rect1.width > rect2.x &&
-        rect1.y < rect2.y + rect2.height &&
-        rect1.y + rect1.height > rect2.y);
-}
+};
 
 inline bool file_exists(const std::string& name) {
     struct stat buffer;
@@ -181,6 +170,11 @@ public:
     }
 };
 
+// Quantizes a vector the way censuses send it
+inline array<int16_t, 2> census_pair(const Vector2& vector) { // NOLINT
+    return {(int16_t) vector.x, (int16_t) vector.y};
+}
+
 inline bool circle_collision(const Vector2& pos1, unsigned int radius1, const Vector2& pos2, unsigned int radius2) { // NOLINT
     float dx = pos1.x - pos2.x;
     float dy = pos1.y - pos2.y;
@@ -221,51 +215,555 @@ void ban(ws28::Client* client, bool destroy = true) { // NOLINT
 
 class Arena;
 
-// Base entity
+// Names and chat messages, refcounted and known by small handles so the delta
+// census can send a handle instead of the string. Keys hold the handle in
+// the low 16 bits and the handle's version above it, which changes whenever
+// the handle is reused. Freed handles are reused oldest first, and a handle
+// whose version has run out is retired instead of wrapping, so a stale key
+// never matches a new string.
+class StringTable {
+public:
+    static constexpr uint32_t empty = 0; // the empty string, never stored
+
+    static uint16_t handle(uint32_t key) {
+        return key & UINT16_MAX;
+    }
+
+    // Returns the key of str, adding it if it isn't in the table yet. Every
+    // key returned must be given back with release().
+    uint32_t intern(const string& str) {
+        if (str.empty()) {
+            return empty;
+        }
+
+        auto existing = keys.find(str);
+        if (existing != keys.end()) {
+            entries[handle(existing->second)].refs++;
+            return existing->second;
+        }
+
+        uint16_t index;
+        if (!free_handles.empty()) {
+            index = free_handles.front();
+            free_handles.pop_front();
+        } else if (entries.size() <= UINT16_MAX) {
+            index = entries.size();
+            entries.emplace_back();
+        } else {
+            WARN("String table is full, interning \"" << str << "\" as an empty string");
+            return empty;
+        }
+
+        Entry& entry = entries[index];
+        entry.value = str;
+        entry.refs = 1;
+        uint32_t key = (uint32_t) ++entry.version << 16 | index;
+        keys[str] = key;
+        return key;
+    }
+
+    void release(uint32_t key) {
+        if (key == empty) {
+            return;
+        }
+        Entry& entry = entries[handle(key)];
+        if (--entry.refs == 0) {
+            keys.erase(entry.value);
+            entry.value.clear();
+            if (entry.version != UINT16_MAX) {
+                free_handles.push_back(handle(key));
+            }
+        }
+    }
+
+    const string& get(uint32_t key) const {
+        return entries[handle(key)].value;
+    }
+
+private:
+    struct Entry {
+        string value;
+        unsigned int refs = 0;
+        uint16_t version = 0;
+    };
+
+    vector<Entry> entries {1}; // by handle, 0 being the empty string
+    unordered_map<string, uint32_t> keys;
+    std::deque<uint16_t> free_handles; // oldest first
+};
+
+// An entity's census fields, quantized the way they go over the wire, so two
+// of them can be compared to find what a client has not seen yet.
+struct CensusState {
+    uint8_t kind = 0;
+    uint16_t fields = 0; // which CensusFields this kind of entity has
+    array<int16_t, 2> position {};
+    array<int16_t, 2> velocity {};
+    float rotation = 0;
+    float health = 0;
+    uint16_t radius = 0;
+    uint8_t mockup = 0;
+    uint32_t owner = 0;
+    uint32_t name = StringTable::empty; // StringTable keys
+    uint32_t message = StringTable::empty;
+
+    // Returns the fields that differ from prev
+    uint16_t diff(const CensusState& prev) const {
+        if (prev.kind != kind) {
+            return fields;
+        }
+
+        uint16_t changed = 0;
+        if (position != prev.position) changed |= (uint16_t) CensusField::Position;
+        if (velocity != prev.velocity) changed |= (uint16_t) CensusField::Velocity;
+        if (rotation != prev.rotation) changed |= (uint16_t) CensusField::Rotation;
+        if (health != prev.health) changed |= (uint16_t) CensusField::Health;
+        if (radius != prev.radius) changed |= (uint16_t) CensusField::Radius;
+        if (mockup != prev.mockup) changed |= (uint16_t) CensusField::Mockup;
+        if (name != prev.name) changed |= (uint16_t) CensusField::Name;
+        if (message != prev.message) changed |= (uint16_t) CensusField::Message;
+        if (owner != prev.owner) changed |= (uint16_t) CensusField::Owner;
+        return changed & fields;
+    }
+
+    // Writes the fields set in changed, in CensusField order. Strings are
+    // written as their handles when interned is set.
+    void put(StreamPeerBuffer& buf, uint16_t changed, const StringTable& strings, bool interned) const {
+        size_t size = 0;
+        if (changed & (uint16_t) CensusField::Position) size += packets::I16Pair::size;
+        if (changed & (uint16_t) CensusField::Velocity) size += packets::I16Pair::size;
+        if (changed & (uint16_t) CensusField::Rotation) size += packets::F32::size;
+        if (changed & (uint16_t) CensusField::Health) size += packets::F32::size;
+        if (changed & (uint16_t) CensusField::Radius) size += packets::U16::size;
+        if (changed & (uint16_t) CensusField::Mockup) size += packets::U8::size;
+        if (changed & (uint16_t) CensusField::Name) size += interned ? packets::U16::size : packets::Str::size_of(strings.get(name));
+        if (changed & (uint16_t) CensusField::Message) size += interned ? packets::U16::size : packets::Str::size_of(strings.get(message));
+        if (changed & (uint16_t) CensusField::Owner) size += packets::U32::size;
+
+        uint8_t* dst = buf.skip(size);
+        bool swap = buf.big_endian;
+        if (changed & (uint16_t) CensusField::Position) packets::I16Pair::store(dst, position, swap);
+        if (changed & (uint16_t) CensusField::Velocity) packets::I16Pair::store(dst, velocity, swap);
+        if (changed & (uint16_t) CensusField::Rotation) packets::F32::store(dst, rotation, swap);
+        if (changed & (uint16_t) CensusField::Health) packets::F32::store(dst, health, swap);
+        if (changed & (uint16_t) CensusField::Radius) packets::U16::store(dst, radius, swap);
+        if (changed & (uint16_t) CensusField::Mockup) packets::U8::store(dst, mockup, swap);
+        if (changed & (uint16_t) CensusField::Name) put_string(dst, name, strings, interned, swap);
+        if (changed & (uint16_t) CensusField::Message) put_string(dst, message, strings, interned, swap);
+        if (changed & (uint16_t) CensusField::Owner) packets::U32::store(dst, owner, swap);
+    }
+
+private:
+    static void put_string(uint8_t*& dst, uint32_t key, const StringTable& strings, bool interned, bool swap) {
+        if (interned) {
+            packets::U16::store(dst, StringTable::handle(key), swap);
+        } else {
+            packets::Str::store(dst, strings.get(key), swap);
+        }
+    }
+};
+
+// An entity's census for the current tick, built at most once and shared by
+// every tank that can see it
+struct CensusCache {
+    unsigned long long fragment_tick = ULLONG_MAX;
+    size_t fragment_offset = 0; // into Arena::census_fragments
+    size_t fragment_size = 0;
+    unsigned long long state_tick = ULLONG_MAX;
+    CensusState state;
+};
+
+// What a client was last sent about an entity
+struct CensusSnapshot {
+    CensusState state;
+    unsigned long long tick; // last tick the entity was in view
+};
+
+// Matches the kind byte in censuses
+enum class EntityKind : uint8_t {
+    Tank = 0,
+    Shape = 1,
+    Bullet = 2
+};
+
+// The broadphase category bit of a kind of entity
+inline uint32_t category_of(EntityKind kind) { // NOLINT
+    return 1u << (uint8_t) kind;
+}
+
+// Where an entity lives
+struct Handle {
+    EntityKind kind;
+    unsigned int slot;
+    unsigned int generation; // bumped every time the handle is freed
+    bool dying;              // destroyed, but not removed until the tick ends
+};
+
+// Hands out the ids of an arena's entities and finds them again. An id is a
+// handle index in its low bits and that handle's generation in its high
+// bits. Freed handles are reused, which keeps indices dense enough to index
+// the table directly, and the generation is bumped every time, so a reused
+// handle comes back under a different id. Handles are reused oldest first,
+// so churn is spread over every free index and an id only repeats once its
+// index has been reused 65536 times. A client that still remembers the
+// entity from that long ago could mistake the new one for it.
+class HandleTable {
+public:
+    static constexpr unsigned int index_bits = 16;
+    static constexpr unsigned int index_mask = (1u << index_bits) - 1;
+    static constexpr unsigned int generation_mask = UINT32_MAX >> index_bits;
+
+    vector<Handle> handles;
+    std::deque<unsigned int> free_handles; // oldest first
+
+    // Returns the new entity's id. The last index is never handed out, so no
+    // id is UINT32_MAX (BroadEntity::no_owner).
+    unsigned int acquire(EntityKind kind, unsigned int slot) {
+        unsigned int index;
+        if (free_handles.empty()) {
+            index = handles.size();
+            if (index >= index_mask) {
+                ERR("Out of entity handles, more than " << index_mask << " entities in one arena");
+                abort();
+            } else if (index == index_mask - index_mask / 8) {
+                WARN("Entity handles are close to running out");
+            }
+            handles.push_back(Handle {kind, slot, 0, false});
+        } else {
+            index = free_handles.front();
+            free_handles.pop_front();
+            handles[index].kind = kind;
+            handles[index].slot = slot;
+            handles[index].dying = false;
+        }
+        return handles[index].generation << index_bits | index;
+    }
+
+    void release(unsigned int id) {
+        unsigned int index = id & index_mask;
+        handles[index].generation = (handles[index].generation + 1) & generation_mask;
+        free_handles.push_back(index);
+    }
+
+    void move(unsigned int id, unsigned int slot) {
+        handles[id & index_mask].slot = slot;
+    }
+
+    bool dying(unsigned int id) const {
+        return handles[id & index_mask].dying;
+    }
+
+    void set_dying(unsigned int id) {
+        handles[id & index_mask].dying = true;
+    }
+
+    // Returns nullptr if the entity is gone
+    const Handle* resolve(unsigned int id) const {
+        unsigned int index = id & index_mask;
+        if (index >= handles.size() || handles[index].generation != id >> index_bits) {
+            return nullptr;
+        }
+        return &handles[index];
+    }
+};
+
+// The fields every entity of one kind touches each tick, one array per field
+// and indexed by slot, so the physics and census loops walk them in order
+// instead of chasing a pointer per entity.
+struct EntityArrays {
+    vector<Vector2> position;
+    vector<Vector2> velocity;
+    vector<unsigned short> radius;
+    vector<float> health;
+    vector<float> mass;
+    vector<BroadEntity> bounds; // fat box, as last given to the broadphase
+    vector<unsigned int> ids;
+    vector<unsigned char> idle_ticks; // ticks spent all but still, see settle()
+
+    // Bytes taken up by one slot across the columns above
+    static constexpr size_t slot_size = sizeof(Vector2) * 2 + sizeof(unsigned short) + sizeof(float) * 2 +
+                                        sizeof(BroadEntity) + sizeof(unsigned int) + sizeof(unsigned char);
+
+    size_t size() const {
+        return ids.size();
+    }
+
+    // Applies velocity and friction to the entity in slot, keeping it inside
+    // the arena
+    void step(size_t slot, float friction, float delta, unsigned short arena_size) {
+        Vector2& position = this->position[slot];
+        Vector2& velocity = this->velocity[slot];
+        velocity *= Vector2(friction, friction);
+        position += velocity * Vector2(delta, delta) / Vector2(mass[slot], mass[slot]);
+
+        if (position.x > arena_size) {
+            position.x = arena_size;
+            velocity.x = 0;
+        } else if (position.x < 0) {
+            position.x = 0;
+            velocity.x = 0;
+        }
+        if (position.y > arena_size) {
+            position.y = arena_size;
+            velocity.y = 0;
+        } else if (position.y < 0) {
+            position.y = 0;
+            velocity.y = 0;
+        }
+    }
+
+    // Counts how long the entity in slot has been all but still, and stops it
+    // once it's been long enough for it to fall asleep. Sleeping entities
+    // aren't moved and don't look for collisions until something wakes them
+    // by touching them.
+    void settle(size_t slot) {
+        Vector2& velocity = this->velocity[slot];
+        if (abs(velocity.x) >= SLEEP_VELOCITY || abs(velocity.y) >= SLEEP_VELOCITY) {
+            idle_ticks[slot] = 0;
+        } else if (idle_ticks[slot] < SLEEP_TICKS && ++idle_ticks[slot] == SLEEP_TICKS) {
+            velocity = Vector2(0, 0);
+        }
+    }
+
+    bool asleep(size_t slot) const {
+        return idle_ticks[slot] >= SLEEP_TICKS;
+    }
+
+    void wake(size_t slot) {
+        idle_ticks[slot] = 0;
+    }
+
+    // Refits the bounds of the entity in slot once its exact box has left
+    // them. The new bounds are fattened by FAT_MARGIN, and further ahead of
+    // the entity the faster it's going, so it can drift a few ticks before
+    // they need refitting again. Returns true if the broadphase needs to hear
+    // about them.
+    bool update_bounds(size_t slot) {
+        BroadEntity& bounds = this->bounds[slot];
+        const Vector2& position = this->position[slot];
+        const Vector2& velocity = this->velocity[slot];
+        float radius = this->radius[slot];
+
+        if (position.x - radius >= bounds.x &&
+            position.y - radius >= bounds.y &&
+            position.x + radius <= bounds.x + bounds.width &&
+            position.y + radius <= bounds.y + bounds.height) {
+            return false;
+        }
+
+        float ahead_x = FAT_MARGIN + abs(velocity.x) * FAT_TICKS;
+        float ahead_y = FAT_MARGIN + abs(velocity.y) * FAT_TICKS;
+        bounds.x = position.x - radius - (velocity.x < 0 ? ahead_x : FAT_MARGIN);
+        bounds.y = position.y - radius - (velocity.y < 0 ? ahead_y : FAT_MARGIN);
+        bounds.width = radius * 2 + FAT_MARGIN + ahead_x;
+        bounds.height = radius * 2 + FAT_MARGIN + ahead_y;
+        return true;
+    }
+
+protected:
+    void push(unsigned int id, unsigned short radius, float health, float mass, uint32_t category, uint32_t owner) {
+        this->position.emplace_back();
+        this->velocity.emplace_back();
+        this->radius.push_back(radius);
+        this->health.push_back(health);
+        this->mass.push_back(mass);
+        this->bounds.push_back(BroadEntity {id, category, owner});
+        this->ids.push_back(id);
+        this->idle_ticks.push_back(0);
+    }
+
+    // Moves the last slot into slot and drops the last one
+    void swap_remove(size_t slot) {
+        size_t last = size() - 1;
+        if (slot != last) {
+            position[slot] = position[last];
+            velocity[slot] = velocity[last];
+            radius[slot] = radius[last];
+            health[slot] = health[last];
+            mass[slot] = mass[last];
+            bounds[slot] = bounds[last];
+            ids[slot] = ids[last];
+            idle_ticks[slot] = idle_ticks[last];
+        }
+        position.pop_back();
+        velocity.pop_back();
+        radius.pop_back();
+        health.pop_back();
+        mass.pop_back();
+        bounds.pop_back();
+        ids.pop_back();
+        idle_ticks.pop_back();
+    }
+};
+
+// Every entity of one kind. Removing one moves the last into its slot, so
+// slots stay dense.
+template <typename T>
+class EntityStore: public EntityArrays {
+public:
+    vector<T*> objects; // by slot
+    vector<typename T::Details> details; // cold data, by slot
+    HandleTable* handles;
+    ObjectPool<T> pool; // where the objects live
+
+    EntityStore(HandleTable* handles) :
+        handles(handles) { }
+
+    ~EntityStore() {
+        for (T* entity : objects) {
+            pool.destroy(entity);
+        }
+    }
+
+    // Creates an entity with a new id in a new slot with its kind's defaults
+    T* create() {
+        T* entity = pool.create();
+        entity->arrays = this;
+        entity->slot = objects.size();
+        entity->id = handles->acquire(T::kind, entity->slot);
+        unsigned short radius = T::initial_radius;
+        float health = T::initial_health;
+        float mass = T::initial_mass;
+        uint32_t owner = BroadEntity::no_owner;
+        if (T::kind == EntityKind::Tank) {
+            owner = entity->id; // so a tank and its bullets never collide
+        }
+        push(entity->id, radius, health, mass, category_of(T::kind), owner);
+        objects.push_back(entity);
+        details.emplace_back();
+        return entity;
+    }
+
+    // Returns the entity with id, or nullptr if there is none
+    T* get(unsigned int id) {
+        return by_handle(handles->resolve(id));
+    }
+
+    // Returns the entity behind handle, or nullptr if it's of another kind
+    T* by_handle(const Handle* handle) {
+        return handle && handle->kind == T::kind ? objects[handle->slot] : nullptr;
+    }
+
+    bool contains(unsigned int id) {
+        return get(id) != nullptr;
+    }
+
+    // Takes the entity with id out of the store and hands it to the caller
+    // to give back to the pool. Returns nullptr if there is none.
+    T* remove(unsigned int id) {
+        T* entity = get(id);
+        if (!entity) {
+            return nullptr;
+        }
+        unsigned int index = entity->slot;
+
+        handles->release(id);
+        swap_remove(index);
+        objects[index] = objects.back();
+        objects.pop_back();
+        if (index != objects.size()) {
+            objects[index]->slot = index;
+            details[index] = std::move(details.back());
+            handles->move(ids[index], index);
+        }
+        details.pop_back();
+        return entity;
+    }
+};
+
+// The entity's cold data. Only valid until an entity of the same kind is
+// removed.
+template <typename T>
+typename T::Details& details_of(T* entity) {
+    return static_cast<EntityStore<T>*>(entity->arrays)->details[entity->slot];
+}
+
+// Base entity. Its hot fields live in the EntityStore that created it, and
+// whatever is only needed now and then in the store's details column.
 class Entity {
 public:
-    Vector2 position;
-    Vector2 velocity;
+    struct Details {
+        CensusCache census_cache;
+    };
+
     unsigned int id;
+    EntityArrays* arrays = nullptr;
+    unsigned int slot = 0;
     float rotation = 0;
     static constexpr float friction = 0.9f;
-    string name = "Entity";
-    unsigned short radius = 50;
-    float max_health = 500;
-    float health = max_health;
-    float damage = 0;
-    float mass = 1;
-    FazoEntity fazo_entity;
-
-    void take_census(StreamPeerBuffer&);
-    void collision_response(Arena*);
-    void next_tick(Arena*);
+    static constexpr unsigned short initial_radius = 50;
+    static constexpr float initial_health = 500;
+    static constexpr float initial_mass = 1;
+
+    Vector2& position() {
+        return arrays->position[slot];
+    }
+
+    Vector2& velocity() {
+        return arrays->velocity[slot];
+    }
+
+    unsigned short& radius() {
+        return arrays->radius[slot];
+    }
+
+    float& health() {
+        return arrays->health[slot];
+    }
+
+    float& mass() {
+        return arrays->mass[slot];
+    }
+
+    BroadEntity& bounds() {
+        return arrays->bounds[slot];
+    }
+
+    bool update_bounds() {
+        return arrays->update_bounds(slot);
+    }
+
+    // Pushes this away from other, once they've been found to collide
+    void push_away_from(const Vector2& other) {
+        float angle = atan2(other.y - this->position().y, other.x - this->position().x);
+        Vector2 push_vec(cos(angle), sin(angle)); // heading vector
+        this->velocity().x += -push_vec.x * COLLISION_STRENGTH;
+        this->velocity().y += -push_vec.y * COLLISION_STRENGTH;
+    }
+
+    void take_census(StreamPeerBuffer&, unsigned long long time);
 };
 
 // A shape, includes cacti and rocks.
 class Shape: public Entity {
 public:
-    unsigned short radius = 100;
-    float mass = 5;
-    float damage = 20;
+    static constexpr EntityKind kind = EntityKind::Shape;
+    static constexpr unsigned short initial_radius = 100;
+    static constexpr float initial_mass = 5;
+    static constexpr float max_health = initial_health;
+    static constexpr float damage = 20;
     float reward = 0.075f;
 
-    Shape() {
-        this->radius = RAND(85, 115);
+    void take_census(StreamPeerBuffer& buf, unsigned long long) {
+        packets::ShapeCensus::put(buf,
+            1,
+            this->id,
+            census_pair(this->position()),
+            this->health() / max_health,
+            this->radius());
     }
 
-    void take_census(StreamPeerBuffer& buf) {
-        buf.put_u8(1);                 // id
-        buf.put_u32(this->id);         // game id
-        buf.put_i16(this->position.x); // position
-        buf.put_i16(this->position.y);
-        buf.put_float(this->health / this->max_health); // health
-        buf.put_u16(this->radius);                      // radius
-        //buf.put_u8(7); // sides
+    void census_state(CensusState& state, unsigned long long) {
+        state.kind = 1;
+        state.fields = (uint16_t) CensusField::Position |
+                       (uint16_t) CensusField::Health |
+                       (uint16_t) CensusField::Radius;
+        state.position = census_pair(this->position());
+        state.health = this->health() / max_health;
+        state.radius = this->radius();
     }
 
-    void next_tick(Arena* arena);
-    void collision_response(Arena* arena);
+    void collide(Arena* arena, const Handle& other, const Vector2& other_position);
 };
 
 class Tank;
@@ -283,17 +781,18 @@ struct Timer {
     float time = 0;
 };
 
-// A tank barrel.
-struct Barrel: public BarrelConfig {
+// A tank barrel's timer state. Its stats are in the matching BarrelConfig of
+// the tank's mockup.
+struct Barrel {
     Timer target_time;
     bool cooling_down = false;
-    unsigned reload = full_reload;
 
-    void fire(Tank*, Arena*) __attribute__((hot));
+    void fire(Tank*, Arena*, const BarrelConfig&) __attribute__((hot));
 };
 
 struct ChatMessage {
     string content;
+    uint32_t key = StringTable::empty; // content in Arena::strings
     unsigned long long time = 0;
 };
 
@@ -310,6 +809,7 @@ enum class TankState {
 // A tank, stats vary based on mockups.
 class Tank: public Entity {
 public:
+    static constexpr EntityKind kind = EntityKind::Tank;
     struct Input {
         bool W = false;
         bool A = false;
@@ -319,62 +819,93 @@ public:
         Vector2 mousepos;
     };
 
-    string name = "Unnamed";
-    ws28::Client* client = nullptr;
+    struct Details: Entity::Details {
+        string name = "Unnamed";
+        uint32_t name_key = StringTable::empty; // name in Arena::strings
+        ws28::Client* client = nullptr;
+        ChatMessage message;
+        array<Barrel, MAX_BARRELS> barrels; // as many in use as the mockup has
+        chrono::time_point<chrono::steady_clock> spawn_time = chrono::steady_clock::now();
+        unordered_map<unsigned int, CensusSnapshot> census_snapshots; // for delta censuses
+        vector<uint32_t> sent_strings;                                // keys sent to the client, by handle
+    };
+
     Input input;
     float movement_speed = 4;
     static constexpr float friction = 0.8f;
-    vector<unique_ptr<Barrel>> barrels;
+    static constexpr float max_health = initial_health;
     unsigned int mockup;
     unsigned char fov;
     float level = 1;
-    ChatMessage message;
     TankType type = TankType::Remote;
     TankState state = TankState::Alive;
-    chrono::time_point<chrono::steady_clock> spawn_time = chrono::steady_clock::now();
+
+    Details& details() {
+        return details_of(this);
+    }
 
     void next_tick(Arena* arena);
-    void collision_response(Arena* arena) __attribute__((hot));
+    void collide(Arena* arena, const Handle& other, const Vector2& other_position) __attribute__((hot));
+    void think(Arena* arena);
+    void send_census(Arena* arena);
+    void send_full_census(Arena* arena, const BroadQuery& query, const BroadEntity* candidates, size_t len);
+    void send_delta_census(Arena* arena, const BroadQuery& query, const BroadEntity* candidates, size_t len);
+
+    BroadQuery view() {
+        float dr = 112.5 * this->fov * 1.6;
+        return BroadQuery {
+            .x = this->position().x - dr / 2,
+            .y = this->position().y - dr / 2,
+            .width = dr,
+            .height = dr,
+        };
+    }
+
+    bool showing_message(unsigned long long time) {
+        const ChatMessage& message = details().message;
+        return message.time != 0 && time - (30 * 5) <= message.time; // show chat messages for 30*5 ticks
+    }
 
     void take_census(StreamPeerBuffer& buf, unsigned long long time) {
-        buf.put_u8(0);                 // id
-        buf.put_u32(this->id);         // game id
-        buf.put_i16(this->position.x); // position
-        buf.put_i16(this->position.y);
-        buf.put_float(this->rotation); // rotation
-        buf.put_i16(this->velocity.x); // velocity
-        buf.put_i16(this->velocity.y);
-        buf.put_u8(this->mockup);                                  // mockup id
-        buf.put_float(this->health / this->max_health);            // health
-        buf.put_u16(this->radius);                                 // radius
-        buf.put_string(this->name);                                // tank name
-        if (message.time == 0 || time - (30 * 5) > message.time) { // show chat messages for 30*5 ticks
-            buf.put_string("");                                    // empty message
-        } else {
-            buf.put_string(message.content);
-        }
+        static const string empty_message;
+        Details& details = this->details();
+        packets::TankCensus::put(buf,
+            0,
+            this->id,
+            census_pair(this->position()),
+            this->rotation,
+            census_pair(this->velocity()),
+            this->mockup,
+            this->health() / max_health,
+            this->radius(),
+            details.name,
+            showing_message(time) ? details.message.content : empty_message);
+    }
+
+    void census_state(CensusState& state, unsigned long long time) {
+        state.kind = 0;
+        state.fields = (uint16_t) CensusField::Position |
+                       (uint16_t) CensusField::Velocity |
+                       (uint16_t) CensusField::Rotation |
+                       (uint16_t) CensusField::Health |
+                       (uint16_t) CensusField::Radius |
+                       (uint16_t) CensusField::Mockup |
+                       (uint16_t) CensusField::Name |
+                       (uint16_t) CensusField::Message;
+        state.position = census_pair(this->position());
+        state.velocity = census_pair(this->velocity());
+        state.rotation = this->rotation;
+        state.health = this->health() / max_health;
+        state.radius = this->radius();
+        state.mockup = this->mockup;
+        state.name = details().name_key;
+        state.message = showing_message(time) ? details().message.key : StringTable::empty;
     }
 
     void define(unsigned int index) {
-        this->barrels.clear();
-
-        const TankConfig& tank = tanksconfig[index];
-        for (const auto& barrel : tank.barrels) {
-            unique_ptr<Barrel> new_barrel(new Barrel);
-            new_barrel->full_reload = barrel.full_reload - barrel.reload_delay;
-            new_barrel->reload = barrel.full_reload;
-            new_barrel->reload_delay = barrel.reload_delay;
-            new_barrel->recoil = barrel.recoil;
-            new_barrel->bullet_speed = barrel.bullet_speed;
-            new_barrel->bullet_damage = barrel.bullet_damage;
-            new_barrel->angle = barrel.angle;
-            new_barrel->width = barrel.width;
-            new_barrel->length = barrel.length;
-            new_barrel->bullet_penetration = barrel.bullet_penetration;
-            this->barrels.push_back(std::move(new_barrel));
-        }
-
-        fov = tank.fov;
+        details().barrels.fill(Barrel());
+
+        fov = tanksconfig[index].fov;
 
         mockup = index;
     }
@@ -382,42 +913,55 @@ public:
 
 class Bullet: public Entity {
 public:
-    unsigned short radius = 25;
+    static constexpr EntityKind kind = EntityKind::Bullet;
+    static constexpr unsigned short initial_radius = 25;
+    static constexpr float initial_health = 10;
     static constexpr float friction = 1;
     float lifetime = 50;
     float damage = 20;
-    float max_health = 10;
-    float health = max_health;
+    float max_health = initial_health;
     unsigned int owner;
 
-    void take_census(StreamPeerBuffer& buf) {
-        buf.put_u8(2);                 // id
-        buf.put_u32(this->id);         // game id
-        buf.put_i16(this->position.x); // position
-        buf.put_i16(this->position.y);
-        buf.put_u16(this->radius);     // radius
-        buf.put_i16(this->velocity.x); // velocity
-        buf.put_i16(this->velocity.y);
-        buf.put_u32(this->owner); // owner of bullet
+    void take_census(StreamPeerBuffer& buf, unsigned long long) {
+        packets::BulletCensus::put(buf,
+            2,
+            this->id,
+            census_pair(this->position()),
+            this->radius(),
+            census_pair(this->velocity()),
+            this->owner);
     }
 
-    void next_tick(Arena* arena);
-    void collision_response(Arena* arena);
+    void census_state(CensusState& state, unsigned long long) {
+        state.kind = 2;
+        state.fields = (uint16_t) CensusField::Position |
+                       (uint16_t) CensusField::Velocity |
+                       (uint16_t) CensusField::Radius |
+                       (uint16_t) CensusField::Owner;
+        state.position = census_pair(this->position());
+        state.velocity = census_pair(this->velocity());
+        state.radius = this->radius();
+        state.owner = this->owner;
+    }
+
+    void collide(Arena* arena, const Handle& other, const Vector2& other_position);
 };
 
 class Arena {
 public:
     struct Entities {
-        unordered_map<unsigned int, Shape*> shapes;
-        unordered_map<unsigned int, Tank*> tanks;
-        unordered_map<unsigned int, Bullet*> bullets;
+        EntityStore<Shape> shapes;
+        EntityStore<Tank> tanks;
+        EntityStore<Bullet> bullets;
     };
 
     unsigned long long ticks = 0;
-    Entities entities;
+    HandleTable handles;
+    StringTable strings; // names and chat messages
+    Entities entities {{&handles}, {&handles}, {&handles}};
     unsigned short target_bot_count = 23;
     unsigned short size = target_bot_count * 1000 + 5000;
-    BroadSolver* solver = FazoSolverNew(size, size, 7);
+    BroadSolver solver {size, size, HandleTable::index_bits};
     unsigned int target_shape_count = size * size / 700000;
 
     uv_timer_t timer;
@@ -425,26 +969,33 @@ public:
     size_t cursor = 0;
     float delta;
     chrono::high_resolution_clock::time_point last_tick;
+    StreamPeerBuffer census_fragments; // this tick's census of every entity in view of a client
+    vector<pair<size_t, size_t>> census_spans; // offset and size of runs of census_fragments
+    vector<spb::Segment> census_segments;
+    StreamPeerBuffer census_header; // of the full census being sent
+    vector<BroadEntity> census_candidates; // only ever grown, see Tank::send_census
+    vector<uint32_t> census_removals;      // ids a delta census is about to list as gone
+    vector<uint32_t> new_strings; // keys a delta census is about to refer to for the first time
+    StreamPeerBufferPool buffers;      // for outbound packets
+    vector<unsigned int> destroyed;    // ids waiting for flush_destroyed()
+    vector<BroadEntity> spawned;       // boxes waiting for flush_spawned()
+    vector<BroadEntity> moved;         // boxes that changed this tick
+#ifdef RECORD_CENSUS
+    size_t census_samples = 0;
+#endif
 
 #ifdef THREADING
     vector<shared_ptr<tp::Task>> tasks;
 #endif
 
     ~Arena() {
-        for (auto entity = this->entities.shapes.cbegin(); entity != this->entities.shapes.cend();) {
-            destroy_entity(entity++->first, this->entities.shapes);
-        }
-        for (auto entity = this->entities.tanks.cbegin(); entity != this->entities.tanks.cend();) {
-            if (entity->second->type == TankType::Remote) {
-                entity->second->client->Close(4000, "Arena Closed", 12);
+        flush_destroyed();
+        for (Tank* tank : entities.tanks.objects) {
+            if (tank->type == TankType::Remote) {
+                tank->details().client->Close(4000, "Arena Closed", 12);
             }
-            destroy_entity(entity++->first, this->entities.tanks);
-        }
-        for (auto entity = this->entities.bullets.cbegin(); entity != this->entities.bullets.cend();) {
-            destroy_entity(entity++->first, this->entities.bullets);
         }
-
-        FazoSolverFree(solver);
+        // The stores give what's left back to their pools
 
         uv_timer_stop(&timer);
     }
@@ -462,6 +1013,16 @@ public:
             return;
         }
         this->size = _size;
+        solver.resize(size, size);
+
+        // Sleeping shapes aren't stepped, so wake the ones left outside a
+        // shrunken arena for step() to pull them back in
+        for (size_t slot = 0; slot < entities.shapes.size(); slot++) {
+            const Vector2& position = entities.shapes.position[slot];
+            if (position.x > size || position.y > size) {
+                entities.shapes.wake(slot);
+            }
+        }
     }
 
     inline void update_size() {
@@ -469,42 +1030,165 @@ public:
         target_shape_count = size * size / 700000;
     }
 
+    // Queues a newly created entity for the broadphase, once it's been
+    // placed. It's inserted with everything else spawned by flush_spawned().
+    template <typename T>
+    void add_to_solver(T* entity) {
+        entity->update_bounds();
+        spawned.push_back(entity->bounds());
+    }
+
+    void flush_spawned() {
+        solver.insert(spawned.data(), spawned.size());
+        spawned.clear();
+    }
+
+    Shape* spawn_shape() {
+        Shape* new_shape = entities.shapes.create();
+        new_shape->radius() = RAND(85, 115);
+        new_shape->position() = Vector2(RAND(0, size), RAND(0, size));
+        add_to_solver(new_shape);
+        return new_shape;
+    }
+
+    // Serializes entity's census into census_fragments the first time it's
+    // asked for this tick
+    template <typename T>
+    const CensusCache& census_fragment(T* entity) {
+        CensusCache& cache = details_of(entity).census_cache;
+        if (cache.fragment_tick != ticks) {
+            cache.fragment_tick = ticks;
+            cache.fragment_offset = census_fragments.offset;
+            entity->take_census(census_fragments, ticks);
+            cache.fragment_size = census_fragments.offset - cache.fragment_offset;
+        }
+        return cache;
+    }
+
+    template <typename T>
+    const CensusState& census_state(T* entity) {
+        CensusCache& cache = details_of(entity).census_cache;
+        if (cache.state_tick != ticks) {
+            cache.state_tick = ticks;
+            entity->census_state(cache.state, ticks);
+        }
+        return cache.state;
+    }
+
+    // Fills dst with the packet made of segments wrapped in a
+    // Packet::Compressed. Returns false if it isn't worth it.
+    bool compress_packet(const spb::Segment* segments, size_t count, StreamPeerBuffer& dst) {
+        size_t len = 0;
+        for (size_t i = 0; i < count; i++) {
+            len += segments[i].size;
+        }
+        if (len < COMPRESSION_MIN_SIZE) {
+            return false;
+        }
+        packets::Compressed::encode(dst);
+        return compressor.compress(segments, count, dst) == 0;
+    }
+
+    // Sends one packet made of segments. Clients that asked for compression
+    // get it compressed straight from the segments. ws28 only sends a single
+    // contiguous buffer, so for everyone else the segments are gathered once,
+    // unless there is only one. A buffer is only checked out when one of
+    // those needs it.
+    void send_segments(ws28::Client* client, const spb::Segment* segments, size_t count) {
+#ifdef RECORD_CENSUS
+        std::ofstream sample("census_samples/" + to_string(ticks) + "-" + to_string(census_samples++), std::ios::binary);
+        for (size_t i = 0; i < count; i++) {
+            sample.write((const char*) segments[i].data, segments[i].size);
+        }
+#endif
+
+        auto client_info = (ClientInfo*) client->GetUserData();
+        if (client_info->has(Capability::Compression)) {
+            PooledBuffer compressed = buffers.checkout();
+            if (compress_packet(segments, count, *compressed)) {
+                client->Send((const char*) compressed->data(), compressed->size(), 0x2);
+                return;
+            }
+        }
+
+        if (count == 1) {
+            client->Send((const char*) segments[0].data, segments[0].size, 0x2);
+        } else {
+            PooledBuffer gathered = buffers.checkout();
+            for (size_t i = 0; i < count; i++) {
+                gathered->put_data(segments[i].data, segments[i].size);
+            }
+            client->Send((const char*) gathered->data(), gathered->size(), 0x2);
+        }
+    }
+
+    void send_compressible(ws28::Client* client, StreamPeerBuffer& buf) {
+        spb::Segment segment = {buf.data(), buf.size()};
+        send_segments(client, &segment, 1);
+    }
+
+    void send_strings(ws28::Client* client, const vector<uint32_t>& keys) {
+        PooledBuffer pooled = buffers.checkout();
+        StreamPeerBuffer& buf = *pooled;
+        packets::Strings::encode(buf, keys.size());
+        for (uint32_t key : keys) {
+            packets::StringEntry::put(buf, StringTable::handle(key), strings.get(key));
+        }
+        send_compressible(client, buf);
+    }
+
+    void set_name(Tank* tank, const string& name) {
+        Tank::Details& details = tank->details();
+        strings.release(details.name_key);
+        details.name = name;
+        details.name_key = strings.intern(name);
+    }
+
+    // An empty message clears the tank's message
+    void set_message(Tank* tank, const string& content) {
+        ChatMessage& message = tank->details().message;
+        strings.release(message.key);
+        message.content = content;
+        message.key = strings.intern(content);
+        message.time = content.empty() ? 0 : ticks;
+    }
+
     void send_init_packet(StreamPeerBuffer& buf, Tank* player) {
-        buf.put_u8((unsigned char) Packet::OutboundInit); // packet id
-        buf.put_u32(player->id);                          // player id
-        buf.put_u8(tanksconfig.size());                   // amount of mockups
+        size_t packet_size = packets::OutboundInit::min_size;
         for (const auto& tank : tanksconfig) {
-            buf.put_string(tank.name);
-            buf.put_u8(tank.fov);
-            buf.put_u8(tank.barrels.size());
+            packet_size += packets::Mockup::size_of(tank.name, tank.fov, tank.barrels.size()) +
+                           packets::MockupBarrel::min_size * tank.barrels.size();
+        }
+        buf.reserve(buf.offset + packet_size);
+
+        packets::OutboundInit::encode(buf, player->id, tanksconfig.size());
+        for (const auto& tank : tanksconfig) {
+            packets::Mockup::put(buf, tank.name, tank.fov, tank.barrels.size());
             for (const auto& barrel : tank.barrels) {
-                buf.put_float(barrel.width);
-                buf.put_float(barrel.length);
-                buf.put_float(barrel.angle);
+                packets::MockupBarrel::put(buf, barrel.width, barrel.length, barrel.angle);
             }
         }
 
-        player->client->Send((const char*) buf.data(), buf.size(), 0x2);
+        player->details().client->Send((const char*) buf.data(), buf.size(), 0x2);
     }
 
     void send_death_packet(StreamPeerBuffer& buf, Tank* player) {
-        buf.put_u8((unsigned char) Packet::Death); // packet id
         auto death_time = chrono::steady_clock::now();
-        chrono::duration<double> elapsed_seconds = death_time - player->spawn_time;
+        chrono::duration<double> elapsed_seconds = death_time - player->details().spawn_time;
         if (elapsed_seconds.count() > 15) {
-            INFO("\"" << player->name << "\" lived for " << elapsed_seconds.count() << "s before dying");
+            INFO("\"" << player->details().name << "\" lived for " << elapsed_seconds.count() << "s before dying");
         } else {
-            BRUH("Noob \"" << player->name << "\" lived for " << elapsed_seconds.count() << "s before dying");
+            BRUH("Noob \"" << player->details().name << "\" lived for " << elapsed_seconds.count() << "s before dying");
         }
-        buf.put_double(elapsed_seconds.count()); // seconds elapsed since spawn
-        player->client->Send((const char*) buf.data(), buf.size(), 0x2);
+        packets::Death::encode(buf, elapsed_seconds.count());
+        player->details().client->Send((const char*) buf.data(), buf.size(), 0x2);
     }
 
-    void handle_init_packet(StreamPeerBuffer& buf, ws28::Client* client) {
+    void handle_init_packet(StreamPeerView& buf, ws28::Client* client) {
         auto client_info = (ClientInfo*) client->GetUserData();
 
         if (client_info->authenticated) {
-            if (in_map(this->entities.tanks, client_info->id)) {
+            if (entities.tanks.contains(client_info->id)) {
                 WARN("Existing player tried to send init packet");
             } else {
                 WARN("Non-existent player with non-null id tried to send init packet");
@@ -515,10 +1199,12 @@ public:
         }
 
         string player_name;
-        if (buf.get_string(player_name) != 0) {
+        if (!packets::InboundInit::decode(buf, player_name)) {
             WARN("Client tried to send invalid init packet");
             ban(client);
             return;
+        } else if (buf.size() - buf.offset == packets::InboundInitCapabilities::min_size) {
+            packets::InboundInitCapabilities::get(buf, client_info->capabilities);
         } else if (buf.size() - buf.offset != 0) {
             WARN("Client tried to send invalid init packet");
             ban(client);
@@ -527,33 +1213,22 @@ public:
         if (player_name.size() == 0) {
             player_name = "Unnamed";
         }
-        player_name = truncate(player_name, 14, false);
-        Tank* new_player = new Tank;
-        new_player->name = player_name;
-        new_player->client = client;
+        Tank* new_player = entities.tanks.create();
+        const unsigned int player_id = new_player->id;
+        set_name(new_player, player_name);
+        new_player->details().client = client;
 
-        const unsigned int player_id = get_uid();
         client_info->id = player_id;
-        new_player->id = player_id;
-        this->entities.tanks[player_id] = new_player;
         client_info->authenticated = true;
-        new_player->position = Vector2(RAND(0, size), RAND(0, size));
+        new_player->position() = Vector2(RAND(0, size), RAND(0, size));
         new_player->define(RAND(0, tanksconfig.size() - 1));
-
-        new_player->fazo_entity.id = new_player->id;
-        new_player->fazo_entity.radius = new_player->radius;
-        new_player->fazo_entity.x = new_player->position.x - new_player->radius;
-        new_player->fazo_entity.y = new_player->position.y - new_player->radius;
-        new_player->fazo_entity.width = new_player->radius * 2;
-        new_player->fazo_entity.height = new_player->radius * 2;
-        FazoSolverInsert(solver, &new_player->fazo_entity);
+        add_to_solver(new_player);
 
         INFO("New player with name \"" << player_name << "\" and id " << player_id << " joined. There are currently " << entities.tanks.size() << " player(s) in game");
 
         update_size();
 
-        buf.reset();
-        send_init_packet(buf, new_player);
+        send_init_packet(*buffers.checkout(), new_player);
 
         // tracking
         std::string value;
@@ -569,20 +1244,22 @@ public:
         }
     }
 
-    void handle_input_packet(StreamPeerBuffer& buf, ws28::Client* client) {
+    void handle_input_packet(StreamPeerView& buf, ws28::Client* client) {
         auto client_info = (ClientInfo*) client->GetUserData();
 
-        if (!in_map(this->entities.tanks, client_info->id)) {
+        Tank* player = entities.tanks.get(client_info->id);
+        if (!player) {
             WARN("Player without id tried to send input packet");
             ban(client);
             return;
-        } else if (entities.tanks[client_info->id]->state == TankState::Dead) {
+        } else if (player->state == TankState::Dead) {
             WARN("Dead player tried to send input packet");
             return;
         }
-        Tank* player = entities.tanks[client_info->id];
 
-        unsigned char movement_byte = buf.get_u8();
+        unsigned char movement_byte;
+        packets::I16Pair::type mousepos;
+        packets::Input::decode(buf, movement_byte, mousepos);
         player->input = {.W = false, .A = false, .S = false, .D = false, .mousedown = false};
 
         if (0b10000 & movement_byte) {
@@ -605,91 +1282,191 @@ public:
             player->input.mousedown = true;
         }
 
-        short mousex = buf.get_i16();
-        short mousey = buf.get_i16();
-        player->input.mousepos = Vector2(mousex, mousey);
+        player->input.mousepos = Vector2(mousepos[0], mousepos[1]);
         player->rotation = atan2(
-            player->input.mousepos.y - player->position.y,
-            player->input.mousepos.x - player->position.x);
+            player->input.mousepos.y - player->position().y,
+            player->input.mousepos.x - player->position().x);
     }
 
-    void handle_chat_packet(StreamPeerBuffer& buf, ws28::Client* client) {
+    void handle_chat_packet(StreamPeerView& buf, ws28::Client* client) {
         auto client_info = (ClientInfo*) client->GetUserData();
 
-        if (!in_map(this->entities.tanks, client_info->id)) {
+        Tank* player = entities.tanks.get(client_info->id);
+        if (!player) {
             WARN("Player without id tried to send chat packet");
             ban(client);
             return;
-        } else if (entities.tanks[client_info->id]->state == TankState::Dead) {
+        } else if (player->state == TankState::Dead) {
             WARN("Dead player tried to send chat packet");
             return;
         }
-        Tank* player = entities.tanks[client_info->id];
 
         string message;
-        if (buf.get_string(message) != 0) {
+        if (!packets::Chat::decode(buf, message)) {
             WARN("Player tried to send invalid chat packet");
             destroy_entity(client_info->id, this->entities.tanks);
             ban(client);
             return;
         }
         if (message.size() == 0) {
-            player->message.time = 0;
+            set_message(player, message);
             return;
         }
 
-        player->message.time = ticks;
-        player->message.content = truncate(message, 100, true);
-        INFO("\"" << player->name << "\" says: " << player->message.content);
+        set_message(player, truncate(message, 100, true));
+        INFO("\"" << player->details().name << "\" says: " << player->details().message.content);
     }
 
-    void handle_respawn_packet(StreamPeerBuffer& buf, ws28::Client* client) {
+    void handle_respawn_packet(StreamPeerView& buf, ws28::Client* client) {
         auto client_info = (ClientInfo*) client->GetUserData();
 
-        if (!in_map(this->entities.tanks, client_info->id)) {
+        Tank* player = entities.tanks.get(client_info->id);
+        if (!player) {
             WARN("Player without id tried to send respawn packet");
             ban(client);
             return;
-        } else if (entities.tanks[client_info->id]->state == TankState::Alive) {
+        } else if (player->state == TankState::Alive) {
             WARN("Living player tried to send respawn packet");
             destroy_entity(client_info->id, this->entities.tanks);
             ban(client);
             return;
         }
-        Tank* player = entities.tanks[client_info->id];
 
-        player->position = Vector2(RAND(0, size), RAND(0, size));
-        player->health = player->max_health;
+        player->position() = Vector2(RAND(0, size), RAND(0, size));
+        player->health() = Tank::max_health;
         if (player->level / 2 >= 1) {
             player->level = player->level / 2;
         } else {
             player->level = 1;
         }
         player->state = TankState::Alive;
-        FazoSolverInsert(solver, &player->fazo_entity);
-        player->spawn_time = chrono::steady_clock::now();
+        add_to_solver(player);
+        player->details().spawn_time = chrono::steady_clock::now();
     }
 
+    // Marks an entity as destroyed. It's skipped by everything from then on,
+    // but only removed by flush_destroyed() at the end of the tick, so
+    // nothing is moved or freed while the world is being read.
     template <typename T>
-    void destroy_entity(unsigned int entity_id, unordered_map<unsigned int, T*>& entity_map) {
-        T* entity_ptr = entity_map[entity_id];
+    void destroy_entity(unsigned int entity_id, EntityStore<T>& store) {
+        if (store.contains(entity_id) && !handles.dying(entity_id)) {
+            handles.set_dying(entity_id);
+            destroyed.push_back(entity_id);
+        }
+    }
 
-        entity_map.erase(entity_id);
-        FazoSolverDelete(solver, entity_id);
+    template <typename T>
+    void remove_entity(unsigned int entity_id, EntityStore<T>& store) {
+        if (T* entity_ptr = store.remove(entity_id)) {
+            store.pool.destroy(entity_ptr);
+        }
+    }
+
+    // Narrowphase for one overlapping pair from the broadphase, on the exact
+    // positions in the stores rather than the broadphase's fat boxes. Both
+    // sides respond to each other, and a shape that's touched wakes up. Pairs
+    // that never collide, like a tank and its own bullets, share an owner tag
+    // and don't make it out of the broadphase.
+    void collide(const BroadEntity& a, const BroadEntity& b) {
+        const Handle* handle_a = handles.resolve(a.id);
+        const Handle* handle_b = handles.resolve(b.id);
+        if (!handle_a || !handle_b || handle_a->dying || handle_b->dying) {
+            return;
+        }
+        if (asleep(*handle_a) && asleep(*handle_b)) {
+            return;
+        }
+
+        const EntityArrays& arrays_a = arrays_of(*handle_a);
+        const EntityArrays& arrays_b = arrays_of(*handle_b);
+        Vector2 position_a = arrays_a.position[handle_a->slot];
+        Vector2 position_b = arrays_b.position[handle_b->slot];
+        if (!circle_collision(position_a, arrays_a.radius[handle_a->slot], position_b, arrays_b.radius[handle_b->slot])) {
+            return;
+        }
+
+        respond(*handle_a, *handle_b, position_b);
+        respond(*handle_b, *handle_a, position_a);
+    }
 
-        if (entity_ptr != nullptr) {
-            delete entity_ptr;
+    const EntityArrays& arrays_of(const Handle& handle) const {
+        switch (handle.kind) {
+            case EntityKind::Tank: return entities.tanks;
+            case EntityKind::Shape: return entities.shapes;
+            default: return entities.bullets;
         }
-        if (typeid(T) == typeid(Tank)) {
+    }
+
+    // Whether the exact box of the entity behind handle overlaps query. The
+    // broadphase only knows fat boxes, which reach past the entity.
+    bool in_view(const BroadQuery& query, const Handle& handle) const {
+        const EntityArrays& arrays = arrays_of(handle);
+        const Vector2& position = arrays.position[handle.slot];
+        float radius = arrays.radius[handle.slot];
+        return position.x - radius < query.x + query.width &&
+               position.x + radius > query.x &&
+               position.y - radius < query.y + query.height &&
+               position.y + radius > query.y;
+    }
+
+    bool asleep(const Handle& handle) {
+        return handle.kind == EntityKind::Shape && entities.shapes.asleep(handle.slot);
+    }
+
+    void respond(const Handle& handle, const Handle& other, const Vector2& other_position) {
+        switch (handle.kind) {
+            case EntityKind::Tank:
+                entities.tanks.objects[handle.slot]->collide(this, other, other_position);
+                break;
+            case EntityKind::Shape:
+                entities.shapes.wake(handle.slot);
+                entities.shapes.objects[handle.slot]->collide(this, other, other_position);
+                break;
+            case EntityKind::Bullet:
+                entities.bullets.objects[handle.slot]->collide(this, other, other_position);
+                break;
+        }
+    }
+
+    // Takes everything destroyed since the last flush out of the broadphase
+    // and the stores, and resizes the arena once if a tank left
+    void flush_destroyed() {
+        flush_spawned(); // so nothing destroyed is inserted afterwards
+        for (unsigned int id : destroyed) {
+            solver.remove(id);
+        }
+
+        bool tank_destroyed = false;
+        for (unsigned int id : destroyed) {
+            switch (handles.resolve(id)->kind) {
+                case EntityKind::Tank: {
+                    Tank::Details& details = entities.tanks.get(id)->details();
+                    strings.release(details.name_key);
+                    strings.release(details.message.key);
+                    remove_entity(id, entities.tanks);
+                    tank_destroyed = true;
+                    break;
+                }
+                case EntityKind::Shape:
+                    remove_entity(id, entities.shapes);
+                    break;
+                case EntityKind::Bullet:
+                    remove_entity(id, entities.bullets);
+                    break;
+            }
+        }
+        destroyed.clear();
+
+        if (tank_destroyed) {
             update_size();
         }
     }
 
     void update_lb(StreamPeerBuffer& buf) {
         std::list<Tank*> leaderboard;
-        for (const auto& tank : entities.tanks) {
-            if (tank.second->state == TankState::Alive) {
-                leaderboard.push_back(tank.second);
+        for (Tank* tank : entities.tanks.objects) {
+            if (tank->state == TankState::Alive && !handles.dying(tank->id)) {
+                leaderboard.push_back(tank);
             }
         }
 
@@ -697,22 +1474,40 @@ public:
             return tank1->level > tank2->level;
         });
 
-        buf.put_u8((unsigned char) Packet::Leaderboard);
         unsigned char lb_size = min(leaderboard.size(), decltype(leaderboard)::size_type(10));
-        buf.put_u8(lb_size);
-        for (auto entry = leaderboard.begin(); entry != std::next(leaderboard.begin(), 10); entry++) {
-            buf.put_string((*entry)->name);
-            buf.put_float((*entry)->level);
-            buf.put_u8((*entry)->mockup);
+        buf.reserve(buf.offset + packets::Leaderboard::min_size + lb_size * (packets::LeaderboardEntry::min_size + 14)); // names are at most 14 chars
+        packets::Leaderboard::encode(buf, lb_size);
+        for (auto entry = leaderboard.begin(); entry != std::next(leaderboard.begin(), lb_size); entry++) {
+            packets::LeaderboardEntry::put(buf, (*entry)->details().name, (*entry)->level, (*entry)->mockup);
         }
 
-        for (const auto& tank : entities.tanks) {
-            if (tank.second->type == TankType::Remote) {
-                tank.second->client->Send((const char*) buf.data(), buf.size(), 0x2);
+        PooledBuffer compressed = buffers.checkout();
+        spb::Segment segment = {buf.data(), buf.size()};
+        bool compressed_ok = compress_packet(&segment, 1, *compressed);
+        for (Tank* tank : entities.tanks.objects) {
+            if (tank->type == TankType::Remote && !handles.dying(tank->id)) {
+                auto client_info = (ClientInfo*) tank->details().client->GetUserData();
+                if (compressed_ok && client_info->has(Capability::Compression)) {
+                    tank->details().client->Send((const char*) compressed->data(), compressed->size(), 0x2);
+                } else {
+                    tank->details().client->Send((const char*) buf.data(), buf.size(), 0x2);
+                }
             }
         }
     }
 
+#ifdef DEBUG_POOLS
+    template <typename T>
+    void log_pool(const char* name, const ObjectPool<T>& pool) {
+        INFO(name << " pool: " << pool.live() << "/" << pool.capacity() << " live in " << pool.slab_count() << " slab(s), " << pool.allocations << " allocation(s), " << pool.frees << " free(s)");
+    }
+
+    template <typename T>
+    void log_size(const char* name) {
+        INFO(name << " size: " << sizeof(T) << " byte object, " << EntityArrays::slot_size << " bytes in columns, " << sizeof(typename T::Details) << " byte details");
+    }
+#endif
+
     void update() __attribute__((hot)) {
         auto this_tick = chrono::high_resolution_clock::now();
         delta = (chrono::duration_cast<chrono::microseconds>(this_tick - last_tick).count() / 1000.f) / (1000.f / DELTA_TPS);
@@ -724,179 +1519,174 @@ public:
         last_tick = this_tick;
 
         bool found_player = false;
-        for (const auto& tank : entities.tanks) {
-            if (tank.second->type == TankType::Remote) {
+        for (Tank* tank : entities.tanks.objects) {
+            if (tank->type == TankType::Remote && !handles.dying(tank->id)) {
                 found_player = true;
                 break;
             }
         }
         if (!found_player) {
+            flush_destroyed();
             return;
         }
 
         ticks++;
+#ifdef DEBUG_POOLS
+        if (ticks % (TARGET_TPS * 10) == 0) {
+            log_pool("Shape", entities.shapes.pool);
+            log_pool("Tank", entities.tanks.pool);
+            log_pool("Bullet", entities.bullets.pool);
+        }
+#endif
 
         if (entities.shapes.size() <= target_shape_count - 12) {
             for (unsigned int i = 0; i < (target_shape_count - entities.shapes.size()); i++) {
-                Shape* new_shape = new Shape;
-                new_shape->id = get_uid();
-                new_shape->position = Vector2(RAND(0, size), RAND(0, size));
-
-                new_shape->fazo_entity.id = new_shape->id;
-                new_shape->fazo_entity.radius = new_shape->radius;
-                new_shape->fazo_entity.x = new_shape->position.x - new_shape->radius;
-                new_shape->fazo_entity.y = new_shape->position.y - new_shape->radius;
-                new_shape->fazo_entity.width = new_shape->radius * 2;
-                new_shape->fazo_entity.height = new_shape->radius * 2;
-                FazoSolverInsert(solver, &new_shape->fazo_entity);
-
-                entities.shapes[new_shape->id] = new_shape;
+                spawn_shape();
             }
         } else if (entities.shapes.size() >= target_shape_count + 12) {
-            while (entities.shapes.size() != target_shape_count) {
-                destroy_entity(entities.shapes.begin()->first, entities.shapes);
+            for (size_t slot = target_shape_count; slot < entities.shapes.size(); slot++) {
+                destroy_entity(entities.shapes.ids[slot], entities.shapes);
             }
         }
 
-        for (auto entity = this->entities.shapes.cbegin(); entity != this->entities.shapes.cend();) {
-            if (entity->second->health <= 0) {
-                this->destroy_entity(entity++->first, this->entities.shapes);
+        for (size_t slot = 0; slot < entities.shapes.size(); slot++) {
+            if (handles.dying(entities.shapes.ids[slot])) {
+                continue;
+            } else if (entities.shapes.health[slot] <= 0) {
+                destroy_entity(entities.shapes.ids[slot], entities.shapes);
+                continue;
+            } else if (entities.shapes.asleep(slot)) {
                 continue;
             }
 
-            entity->second->next_tick(this);
-            ++entity;
+            entities.shapes.step(slot, Shape::friction, delta, size);
+            if (entities.shapes.update_bounds(slot)) {
+                moved.push_back(entities.shapes.bounds[slot]);
+            }
+            entities.shapes.settle(slot);
         }
 
-        for (auto entity = this->entities.tanks.cbegin(); entity != this->entities.tanks.cend();) {
-            if (entity->second->state == TankState::Dead) {
-                ++entity;
+        for (size_t slot = 0; slot < entities.tanks.size(); slot++) {
+            Tank* tank = entities.tanks.objects[slot];
+            if (tank->state == TankState::Dead || handles.dying(tank->id)) {
                 continue;
             }
 
-            if (entity->second->health <= 0) {
-                entity->second->input = {.W = false, .A = false, .S = false, .D = false, .mousedown = false, .mousepos = Vector2(0, 0)};
-                entity->second->health = entity->second->max_health;
-                if (entity->second->type == TankType::Local) {
-                    entity->second->position = Vector2(RAND(0, size), RAND(0, size));
-                    entity->second->health = entity->second->max_health;
-                    if (entity->second->level / 2 >= 1) {
-                        entity->second->level = entity->second->level / 2;
+            if (entities.tanks.health[slot] <= 0) {
+                tank->input = {.W = false, .A = false, .S = false, .D = false, .mousedown = false, .mousepos = Vector2(0, 0)};
+                tank->health() = Tank::max_health;
+                if (tank->type == TankType::Local) {
+                    tank->position() = Vector2(RAND(0, size), RAND(0, size));
+                    if (tank->level / 2 >= 1) {
+                        tank->level = tank->level / 2;
                     } else {
-                        entity->second->level = 1;
+                        tank->level = 1;
                     }
                 } else {
-                    entity->second->state = TankState::Dead;
-                    FazoSolverDelete(solver, entity->first);
-                    StreamPeerBuffer buf(true);
-                    send_death_packet(buf, entity++->second);
+                    tank->state = TankState::Dead;
+                    solver.remove(tank->id);
+                    send_death_packet(*buffers.checkout(), tank);
                     continue;
                 }
             }
 
-            entity->second->next_tick(this);
-
-            ++entity;
+            tank->next_tick(this);
+            entities.tanks.step(slot, Tank::friction, delta, size);
+            if (entities.tanks.update_bounds(slot)) {
+                moved.push_back(entities.tanks.bounds[slot]);
+            }
         }
 
-        for (auto entity = this->entities.bullets.cbegin(); entity != this->entities.bullets.cend();) {
-            entity->second->lifetime -= delta;
-            if (entity->second->lifetime <= 0) {
-                this->destroy_entity(entity++->first, this->entities.bullets);
+        for (size_t slot = 0; slot < entities.bullets.size(); slot++) {
+            Bullet* bullet = entities.bullets.objects[slot];
+            if (handles.dying(bullet->id)) {
                 continue;
-            } else if (entity->second->health <= 0) {
-                this->destroy_entity(entity++->first, this->entities.bullets);
+            }
+            bullet->lifetime -= delta;
+            if (bullet->lifetime <= 0 || entities.bullets.health[slot] <= 0) {
+                destroy_entity(bullet->id, entities.bullets);
                 continue;
             }
 
-            entity->second->next_tick(this);
-            ++entity;
+            entities.bullets.step(slot, Bullet::friction, delta, size);
+            if (entities.bullets.update_bounds(slot)) {
+                moved.push_back(entities.bullets.bounds[slot]);
+            }
         }
-#ifdef THREADING
-        tasks.resize(entities.shapes.size() + entities.tanks.size() + entities.bullets.size());
-        unsigned int i = 0;
-#endif
 
-        for (const auto& entity : this->entities.shapes) {
-#ifdef THREADING
-            tasks[i] = std::move(pool.schedule([entity, this](void*) {
-#endif
-                entity.second->collision_response(this);
-#ifdef THREADING
-            }));
-            i++;
-#endif
-        }
+        // Everything spawned or moved goes into the broadphase in one go
+        flush_spawned();
+        solver.update(moved.data(), moved.size());
+        moved.clear();
 
-        for (const auto& entity : this->entities.tanks) {
+        // Collisions, every overlapping pair once
+        solver.visit_pairs([this](const BroadEntity& a, const BroadEntity& b) {
+            collide(a, b);
+        });
+
+        if (ticks % 2 == 0) {
 #ifdef THREADING
-            tasks[i] = std::move(pool.schedule([entity, this](void*) {
+            tasks.clear();
 #endif
-                entity.second->collision_response(this);
+            for (Tank* tank : entities.tanks.objects) {
+                if (tank->type != TankType::Local || handles.dying(tank->id)) {
+                    continue;
+                }
 #ifdef THREADING
-            }));
-            i++;
+                tasks.push_back(pool.schedule([tank, this](void*) {
 #endif
-        }
-
-        for (const auto& entity : this->entities.bullets) {
+                    tank->think(this);
 #ifdef THREADING
-            tasks[i] = std::move(pool.schedule([entity, this](void*) {
+                }));
 #endif
-                entity.second->collision_response(this);
+            }
+
 #ifdef THREADING
-            }));
-            i++;
+            for (auto& task : tasks) {
+                task->await();
+            }
 #endif
         }
 
-#ifdef THREADING
-        for (auto& task : tasks) {
-            task->await();
+        // Census
+        census_fragments.reset();
+        for (Tank* tank : entities.tanks.objects) {
+            if (tank->type == TankType::Remote && !handles.dying(tank->id)) {
+                tank->send_census(this);
+            }
         }
-#endif
 
         // Leaderboard
         if (ticks % 15 == 0) {
-            StreamPeerBuffer buf;
-            update_lb(buf);
+            update_lb(*buffers.checkout());
         }
+
+        flush_destroyed();
     }
 
     void run() {
-        for (unsigned int i = 0; i < target_shape_count; i++) {
-            Shape* new_shape = new Shape;
-            new_shape->id = get_uid();
-            new_shape->position = Vector2(RAND(0, size), RAND(0, size));
-
-            new_shape->fazo_entity.id = new_shape->id;
-            new_shape->fazo_entity.radius = new_shape->radius;
-            new_shape->fazo_entity.x = new_shape->position.x - new_shape->radius;
-            new_shape->fazo_entity.y = new_shape->position.y - new_shape->radius;
-            new_shape->fazo_entity.width = new_shape->radius * 2;
-            new_shape->fazo_entity.height = new_shape->radius * 2;
-            FazoSolverInsert(solver, &new_shape->fazo_entity);
+#ifdef DEBUG_POOLS
+        log_size<Shape>("Shape");
+        log_size<Tank>("Tank");
+        log_size<Bullet>("Bullet");
+#endif
+        entities.shapes.pool.reserve(target_shape_count + 12);
+        entities.tanks.pool.reserve(target_bot_count + 16);
+        entities.bullets.pool.reserve(target_bot_count * 32); // a few barrels' worth of bullets in flight per tank
 
-            entities.shapes[new_shape->id] = new_shape;
+        for (unsigned int i = 0; i < target_shape_count; i++) {
+            spawn_shape();
         }
 
         for (unsigned int i = 0; i < target_bot_count; i++) {
-            Tank* new_tank = new Tank;
+            Tank* new_tank = entities.tanks.create();
             new_tank->type = TankType::Local;
-            new_tank->id = get_uid();
-            new_tank->position = Vector2(RAND(0, size), RAND(0, size));
+            set_name(new_tank, new_tank->details().name);
+            new_tank->position() = Vector2(RAND(0, size), RAND(0, size));
             new_tank->define(RAND(0, tanksconfig.size() - 1));
-
-            new_tank->fazo_entity.id = new_tank->id;
-            new_tank->fazo_entity.radius = new_tank->radius;
-            new_tank->fazo_entity.x = new_tank->position.x - new_tank->radius;
-            new_tank->fazo_entity.y = new_tank->position.y - new_tank->radius;
-            new_tank->fazo_entity.width = new_tank->radius * 2;
-            new_tank->fazo_entity.height = new_tank->radius * 2;
-            FazoSolverInsert(solver, &new_tank->fazo_entity);
-
-            entities.tanks[new_tank->id] = new_tank;
+            add_to_solver(new_tank);
         }
+        flush_spawned();
         this->update_size();
 
         uv_timer_init(uv_default_loop(), &timer);
@@ -920,354 +1710,359 @@ public:
 
 /* OVERLOADS */
 
-void Barrel::fire(Tank* tank, Arena* arena) { // NOLINT
-    Bullet* new_bullet = new Bullet;
-    new_bullet->position = tank->position + (Vector2(cos(tank->rotation + angle), sin(tank->rotation + angle)).normalize() * Vector2(tank->radius + new_bullet->radius + 1, tank->radius + new_bullet->radius + 1));
-    new_bullet->velocity = Vector2(cos(tank->rotation + this->angle) * bullet_speed, sin(tank->rotation + this->angle) * bullet_speed);
-    tank->velocity -= Vector2(cos(tank->rotation + angle) * (this->recoil / arena->delta), sin(tank->rotation + angle) * (this->recoil / arena->delta));
-    new_bullet->id = get_uid();
+void Barrel::fire(Tank* tank, Arena* arena, const BarrelConfig& config) { // NOLINT
+    float angle = config.angle;
+    Bullet* new_bullet = arena->entities.bullets.create();
+    new_bullet->position() = tank->position() + (Vector2(cos(tank->rotation + angle), sin(tank->rotation + angle)).normalize() * Vector2(tank->radius() + new_bullet->radius() + 1, tank->radius() + new_bullet->radius() + 1));
+    new_bullet->velocity() = Vector2(cos(tank->rotation + angle) * config.bullet_speed, sin(tank->rotation + angle) * config.bullet_speed);
+    tank->velocity() -= Vector2(cos(tank->rotation + angle) * (config.recoil / arena->delta), sin(tank->rotation + angle) * (config.recoil / arena->delta));
     new_bullet->owner = tank->id;
-    new_bullet->radius = this->width * tank->radius;
-
-    new_bullet->fazo_entity.id = new_bullet->id;
-    new_bullet->fazo_entity.radius = new_bullet->radius;
-    new_bullet->fazo_entity.x = new_bullet->position.x - new_bullet->radius;
-    new_bullet->fazo_entity.y = new_bullet->position.y - new_bullet->radius;
-    new_bullet->fazo_entity.width = new_bullet->radius * 2;
-    new_bullet->fazo_entity.height = new_bullet->radius * 2;
-    FazoSolverInsert(arena->solver, &new_bullet->fazo_entity);
+    new_bullet->bounds().owner = tank->id;
+    new_bullet->radius() = config.width * tank->radius();
+    arena->add_to_solver(new_bullet);
 
     // set stats
-    new_bullet->damage = this->bullet_damage;
-    new_bullet->max_health = this->bullet_penetration;
-    new_bullet->health = new_bullet->max_health;
-
-    arena->entities.bullets[new_bullet->id] = new_bullet;
+    new_bullet->damage = config.bullet_damage;
+    new_bullet->max_health = config.bullet_penetration;
+    new_bullet->health() = new_bullet->max_health;
 }
 
-// Example collision response 👇
-void Entity::collision_response(Arena* arena) { // NOLINT
-    FazoEntity* candidates;
-    FazoQuery query {
-        .x = this->fazo_entity.x,
-        .y = this->fazo_entity.y,
-        .width = this->fazo_entity.width,
-        .height = this->fazo_entity.height,
-    };
-    size_t len = FazoSolverSolve(arena->solver, &query, &candidates);
-
-    for (unsigned int i = 0; i < len; i++) {
-        const FazoEntity& candidate = candidates[i];
-        unsigned int cid = candidate.id;
-        if (cid == this->id) {
-            continue;
-        }
-
-        if (circle_collision(Vector2(candidate.x + candidate.radius, candidate.y + candidate.radius), candidate.radius, Vector2(this->position.x, this->position.y), this->radius)) {
-            // response
-            float angle = atan2((candidate.y + candidate.radius) - this->position.y, (candidate.x + candidate.radius) - this->position.x);
-            Vector2 push_vec(cos(angle), sin(angle)); // heading vector
-            this->velocity.x += -push_vec.x * COLLISION_STRENGTH;
-            this->velocity.y += -push_vec.y * COLLISION_STRENGTH;
+void Shape::collide(Arena* arena, const Handle& other, const Vector2& other_position) { // NOLINT
+    if (Bullet* bullet = arena->entities.bullets.by_handle(&other)) {
+        float old_health = this->health();
+        this->health() -= bullet->damage * arena->delta; // damage
+        if (this->health() <= 0 && old_health > 0) {
+            if (Tank* owner = arena->entities.tanks.get(bullet->owner)) {
+                owner->level += this->reward;
+            } else {
+                BRUH("The bullet of a non-existent player hit and killed a shape");
+            }
         }
     }
 
-    if (len) free(candidates);
+    push_away_from(other_position);
 }
 
-void Shape::collision_response(Arena* arena) { // NOLINT
-    FazoEntity* candidates;
-    FazoQuery query {
-        .x = this->fazo_entity.x,
-        .y = this->fazo_entity.y,
-        .width = this->fazo_entity.width,
-        .height = this->fazo_entity.height,
-    };
-    size_t len = FazoSolverSolve(arena->solver, &query, &candidates);
-
-    for (unsigned int i = 0; i < len; i++) {
-        const FazoEntity& candidate = candidates[i];
-        unsigned int cid = candidate.id;
-        if (cid == this->id) {
-            continue;
-        }
-
-        if (circle_collision(Vector2(candidate.x + candidate.radius, candidate.y + candidate.radius), candidate.radius, Vector2(this->position.x, this->position.y), this->radius)) {
-            if (in_map(arena->entities.bullets, cid)) {
-                float old_health = this->health;
-                this->health -= arena->entities.bullets[cid]->damage * arena->delta; // damage
-                if (this->health <= 0 && old_health > 0) {
-                    if (in_map(arena->entities.tanks, arena->entities.bullets[cid]->owner)) {
-                        arena->entities.tanks[arena->entities.bullets[cid]->owner]->level += this->reward;
-                    } else {
-                        BRUH("The bullet of a non-existent player hit and killed a shape");
-                    }
-                }
+void Tank::collide(Arena* arena, const Handle& other, const Vector2& other_position) { // NOLINT
+    if (Bullet* bullet = arena->entities.bullets.by_handle(&other)) {
+        float old_health = this->health();
+        this->health() -= bullet->damage * arena->delta; // damage
+        if (this->health() <= 0 && old_health > 0) {
+            if (Tank* owner = arena->entities.tanks.get(bullet->owner)) {
+                owner->level += this->level / 2;
+            } else {
+                BRUH("The bullet of a non-existent player hit and killed another tank");
             }
-
-            // response
-            float angle = atan2((candidate.y + candidate.radius) - this->position.y, (candidate.x + candidate.radius) - this->position.x);
-            Vector2 push_vec(cos(angle), sin(angle)); // heading vector
-            this->velocity.x += -push_vec.x * COLLISION_STRENGTH;
-            this->velocity.y += -push_vec.y * COLLISION_STRENGTH;
         }
+    } else if (Shape* shape = arena->entities.shapes.by_handle(&other)) {
+        this->health() -= shape->damage * arena->delta; // damage
     }
 
-    if (len) free(candidates);
+    push_away_from(other_position);
 }
 
-void Tank::collision_response(Arena* arena) { // NOLINT
-    FazoEntity* candidates;
-    FazoQuery query {
-        .x = this->fazo_entity.x,
-        .y = this->fazo_entity.y,
-        .width = this->fazo_entity.width,
-        .height = this->fazo_entity.height,
-    };
-    size_t len = FazoSolverSolve(arena->solver, &query, &candidates);
+// Bots look around for something to shoot. Remote tanks see the world
+// through the census instead.
+void Tank::think(Arena* arena) { // NOLINT
+    BroadQuery query = view();
+    query.mask = category_of(EntityKind::Tank) | category_of(EntityKind::Shape);
+    query.exclude_owner = this->id;
+    map<unsigned int, unsigned int> nearby_tanks;
+    map<unsigned int, unsigned int> nearby_shapes;
+
+    arena->solver.visit(query, [&](const BroadEntity& candidate) {
+        const Handle* handle = arena->handles.resolve(candidate.id);
+        if (!handle || handle->dying || !arena->in_view(query, *handle)) {
+            return;
+        }
 
-    for (unsigned int i = 0; i < len; i++) {
-        const FazoEntity& candidate = candidates[i];
-        unsigned int cid = candidate.id;
-        if (cid == this->id) {
-            continue;
-        } else if (in_map(arena->entities.bullets, cid)) {
-            if (arena->entities.bullets[cid]->owner == this->id) {
-                continue;
-            }
+        if (Tank* tank = arena->entities.tanks.by_handle(handle)) {
+            nearby_tanks[tank->id] = tank->position().distance_to(this->position());
+        } else if (Shape* shape = arena->entities.shapes.by_handle(handle)) {
+            nearby_shapes[shape->id] = shape->position().distance_to(this->position());
         }
+    });
+
+    input = {.W = false, .A = false, .S = false, .D = false, .mousedown = true, .mousepos = Vector2(0, 0)};
+
+    unsigned int dist;
+    if (nearby_tanks.size() > 0) {
+        auto sorted_nearby_tanks = flip_map(nearby_tanks);
+        this->input.mousepos = arena->entities.tanks.get(sorted_nearby_tanks.begin()->second)->position();
+        dist = sorted_nearby_tanks.begin()->first;
+    } else if (nearby_shapes.size() > 0) {
+        auto sorted_nearby_shapes = flip_map(nearby_shapes);
+        this->input.mousepos = arena->entities.shapes.get(sorted_nearby_shapes.begin()->second)->position();
+        dist = sorted_nearby_shapes.begin()->first;
+    } else {
+        return;
+    }
 
-        if (circle_collision(Vector2(candidate.x + candidate.radius, candidate.y + candidate.radius), candidate.radius, Vector2(this->position.x, this->position.y), this->radius)) {
-            if (in_map(arena->entities.bullets, cid)) {
-                float old_health = this->health;
-                this->health -= arena->entities.bullets[cid]->damage * arena->delta; // damage
-                if (this->health <= 0 && old_health > 0) {
-                    if (in_map(arena->entities.tanks, arena->entities.bullets[cid]->owner)) {
-                        arena->entities.tanks[arena->entities.bullets[cid]->owner]->level += this->level / 2;
-                    } else {
-                        BRUH("The bullet of a non-existent player hit and killed another tank");
-                    }
-                }
-            } else if (in_map(arena->entities.shapes, cid)) {
-                this->health -= arena->entities.shapes[cid]->damage * arena->delta; // damage
-            }
+    const Vector2& position = this->position();
+    this->rotation = atan2(
+        this->input.mousepos.y - position.y,
+        this->input.mousepos.x - position.x);
+    if (dist > static_cast<unsigned>(400 + this->radius())) {
+        if (position.x > input.mousepos.x &&
+            abs(position.x - input.mousepos.x) > BOT_ACCURACY_THRESHOLD)
+            input.A = true;
+        else if (abs(position.x - input.mousepos.x) > BOT_ACCURACY_THRESHOLD)
+            input.D = true;
+
+        if (position.y > input.mousepos.y &&
+            abs(position.y - input.mousepos.y) > BOT_ACCURACY_THRESHOLD)
+            input.W = true;
+        else if (abs(position.y - input.mousepos.y) > BOT_ACCURACY_THRESHOLD)
+            input.S = true;
+    }
+}
 
-            // response
-            float angle = atan2((candidate.y + candidate.radius) - this->position.y, (candidate.x + candidate.radius) - this->position.x);
-            Vector2 push_vec(cos(angle), sin(angle)); // heading vector
-            this->velocity.x += -push_vec.x * COLLISION_STRENGTH;
-            this->velocity.y += -push_vec.y * COLLISION_STRENGTH;
-        }
+void Bullet::collide(Arena* arena, const Handle& other, const Vector2& other_position) { // NOLINT
+    if (Bullet* bullet = arena->entities.bullets.by_handle(&other)) {
+        this->health() -= bullet->damage * arena->delta; // damage
+    } else if (Shape* shape = arena->entities.shapes.by_handle(&other)) {
+        this->health() -= shape->damage * arena->delta; // damage
     }
 
-    float dr = 112.5 * this->fov * 1.6;
+    push_away_from(other_position);
+}
 
-    if (len) free(candidates);
-    query = {
-        .x = this->position.x - dr / 2,
-        .y = this->position.y - dr / 2,
-        .width = dr,
-        .height = dr,
-    };
-    len = FazoSolverSolve(arena->solver, &query, &candidates);
-
-    if (this->type == TankType::Remote) {
-        StreamPeerBuffer buf(true);
-        unsigned short census_size = 0;
-
-        for (unsigned int i = 0; i < len; i++) {
-            const FazoEntity& candidate = candidates[i];
-
-            unsigned int cid = candidate.id;
-            if (aabb(query, candidate)) {
-                if (in_map(arena->entities.tanks, cid)) {
-                    arena->entities.tanks[cid]->take_census(buf, arena->ticks);
-                    census_size++;
-                } else if (in_map(arena->entities.shapes, cid)) {
-                    arena->entities.shapes[cid]->take_census(buf);
-                    census_size++;
-                } else if (in_map(arena->entities.bullets, cid)) {
-                    arena->entities.bullets[cid]->take_census(buf);
-                    census_size++;
-                } else {
-                    WARN("Non-existent entity in broadphase with id " << cid);
-                }
-            }
-        }
+void Tank::send_census(Arena* arena) { // NOLINT
+    BroadQuery query = view();
+    vector<BroadEntity>& candidates = arena->census_candidates;
+    size_t len = arena->solver.solve(query, candidates.data(), candidates.size());
+    if (len > candidates.size()) {
+        // Didn't fit, grow and ask again. The buffer is shared by every
+        // census, so this stops happening once it fits the busiest view.
+        candidates.resize(len);
+        arena->solver.solve(query, candidates.data(), candidates.size());
+    }
 
-        // Leaderboard
-        // {
-        //     buf.put_u8(0);                       // id
-        //     buf.put_u32(3999999999);             // game id
-        //     buf.put_i16(this->position.x + 900); // position
-        //     buf.put_i16(this->position.y - 500);
-        //     buf.put_float(0); // rotation
-        //     buf.put_i16(0);   // velocity
-        //     buf.put_i16(0);
-        //     buf.put_u8(0);                 // mockup id
-        //     buf.put_float(0);              // health
-        //     buf.put_u16(1);                // radius
-        //     buf.put_string("Leaderboard"); // tank name
-        //     buf.put_string("");            // empty message
-        //     census_size++;
-
-        //     int leaderboard_pos = 1;
-        //     for (const auto& tank : arena->entities.tanks) {
-        //         if (leaderboard_pos > 10) {
-        //             break;
-        //         }
-
-        //         buf.put_u8(0);                             // id
-        //         buf.put_u32(3999999999 + leaderboard_pos); // game id
-        //         buf.put_i16(this->position.x + 900);       // position
-        //         buf.put_i16((this->position.y - 500) + (80 * leaderboard_pos));
-        //         buf.put_float(0); // rotation
-        //         buf.put_i16(0);   // velocity
-        //         buf.put_i16(0);
-        //         buf.put_u8(0);                                                                        // mockup id
-        //         buf.put_float(0);                                                                     // health
-        //         buf.put_u16(1);                                                                       // radius
-        //         buf.put_string(tank.second->name + " - Level " + to_string(int(tank.second->level))); // tank name
-        //         buf.put_string("");                                                                   // empty message
-        //         census_size++;
-        //         leaderboard_pos++;
-        //     }
-        // }
-
-        buf.offset = 0;
-        buf.put_u8((unsigned char) Packet::Census);
-        buf.put_u16(census_size);
-        buf.put_u16(arena->size);
-        buf.put_float(this->level);
-        this->client->Send((const char*) buf.data(), buf.size(), 0x2);
-    } else if (arena->ticks % 2 == 0) {
-        map<unsigned int, unsigned int> nearby_tanks;
-        map<unsigned int, unsigned int> nearby_shapes;
-
-        for (unsigned int i = 0; i < len; i++) {
-            const FazoEntity& candidate = candidates[i];
-
-            unsigned int cid = candidate.id;
-            if (cid == this->id) {
-                continue;
-            }
+    auto client_info = (ClientInfo*) details().client->GetUserData();
+    if (client_info->has(Capability::DeltaCensus)) {
+        send_delta_census(arena, query, candidates.data(), len);
+    } else {
+        send_full_census(arena, query, candidates.data(), len);
+    }
+}
 
-            if (aabb(query, candidate)) {
-                if (in_map(arena->entities.tanks, cid)) {
-                    nearby_tanks[cid] = arena->entities.tanks[cid]->position.distance_to(this->position);
-                } else if (in_map(arena->entities.shapes, cid)) {
-                    nearby_shapes[cid] = arena->entities.shapes[cid]->position.distance_to(this->position);
-                }
-            }
-        }
+void Tank::send_full_census(Arena* arena, const BroadQuery& query, const BroadEntity* candidates, size_t len) { // NOLINT
+    // The body is made of references to the shared census fragments. Those
+    // are only turned into pointers once every fragment in view exists,
+    // since serializing one may move census_fragments.
+    auto& spans = arena->census_spans;
+    spans.clear();
+    unsigned short census_size = 0;
 
-        input = {.W = false, .A = false, .S = false, .D = false, .mousedown = true, .mousepos = Vector2(0, 0)};
+    for (unsigned int i = 0; i < len; i++) {
+        const BroadEntity& candidate = candidates[i];
 
-        unsigned int dist;
-        if (nearby_tanks.size() > 0) {
-            auto sorted_nearby_tanks = flip_map(nearby_tanks);
-            this->input.mousepos = arena->entities.tanks[sorted_nearby_tanks.begin()->second]->position;
-            dist = sorted_nearby_tanks.begin()->first;
-        } else if (nearby_shapes.size() > 0) {
-            auto sorted_nearby_shapes = flip_map(nearby_shapes);
-            this->input.mousepos = arena->entities.shapes[sorted_nearby_shapes.begin()->second]->position;
-            dist = sorted_nearby_shapes.begin()->first;
-        } else {
-            if (len) free(candidates);
-            return;
+        const Handle* handle = arena->handles.resolve(candidate.id);
+        if (!handle) {
+            WARN("Non-existent entity in broadphase with id " << candidate.id);
+            continue;
+        } else if (handle->dying || !arena->in_view(query, *handle)) {
+            continue;
         }
 
-        this->rotation = atan2(
-            this->input.mousepos.y - this->position.y,
-            this->input.mousepos.x - this->position.x);
-        if (dist > static_cast<unsigned>(400 + this->radius)) {
-            if (position.x > input.mousepos.x &&
-                abs(position.x - input.mousepos.x) > BOT_ACCURACY_THRESHOLD)
-                input.A = true;
-            else if (abs(position.x - input.mousepos.x) > BOT_ACCURACY_THRESHOLD)
-                input.D = true;
+        const CensusCache* cache;
+        switch (handle->kind) {
+            case EntityKind::Tank: cache = &arena->census_fragment(arena->entities.tanks.objects[handle->slot]); break;
+            case EntityKind::Shape: cache = &arena->census_fragment(arena->entities.shapes.objects[handle->slot]); break;
+            default: cache = &arena->census_fragment(arena->entities.bullets.objects[handle->slot]); break;
+        }
 
-            if (position.y > input.mousepos.y &&
-                abs(position.y - input.mousepos.y) > BOT_ACCURACY_THRESHOLD)
-                input.W = true;
-            else if (abs(position.y - input.mousepos.y) > BOT_ACCURACY_THRESHOLD)
-                input.S = true;
+        if (!spans.empty() && spans.back().first + spans.back().second == cache->fragment_offset) {
+            spans.back().second += cache->fragment_size;
+        } else {
+            spans.emplace_back(cache->fragment_offset, cache->fragment_size);
         }
+        census_size++;
     }
 
-    if (len) free(candidates);
+    // Leaderboard
+    // {
+    //     buf.put_u8(0);                       // id
+    //     buf.put_u32(3999999999);             // game id
+    //     buf.put_i16(this->position.x + 900); // position
+    //     buf.put_i16(this->position.y - 500);
+    //     buf.put_float(0); // rotation
+    //     buf.put_i16(0);   // velocity
+    //     buf.put_i16(0);
+    //     buf.put_u8(0);                 // mockup id
+    //     buf.put_float(0);              // health
+    //     buf.put_u16(1);                // radius
+    //     buf.put_string("Leaderboard"); // tank name
+    //     buf.put_string("");            // empty message
+    //     census_size++;
+
+    //     int leaderboard_pos = 1;
+    //     for (const auto& tank : arena->entities.tanks) {
+    //         if (leaderboard_pos > 10) {
+    //             break;
+    //         }
+
+    //         buf.put_u8(0);                             // id
+    //         buf.put_u32(3999999999 + leaderboard_pos); // game id
+    //         buf.put_i16(this->position.x + 900);       // position
+    //         buf.put_i16((this->position.y - 500) + (80 * leaderboard_pos));
+    //         buf.put_float(0); // rotation
+    //         buf.put_i16(0);   // velocity
+    //         buf.put_i16(0);
+    //         buf.put_u8(0);                                                                        // mockup id
+    //         buf.put_float(0);                                                                     // health
+    //         buf.put_u16(1);                                                                       // radius
+    //         buf.put_string(tank.second->name + " - Level " + to_string(int(tank.second->level))); // tank name
+    //         buf.put_string("");                                                                   // empty message
+    //         census_size++;
+    //         leaderboard_pos++;
+    //     }
+    // }
+
+    StreamPeerBuffer& header = arena->census_header;
+    header.reset();
+    packets::Census::encode(header, census_size, arena->size, this->level);
+
+    auto& segments = arena->census_segments;
+    segments.clear();
+    segments.push_back({header.data(), header.size()});
+    for (const auto& span : spans) {
+        segments.push_back({arena->census_fragments.data() + span.first, span.second});
+    }
+    arena->send_segments(this->details().client, segments.data(), segments.size());
 }
 
-void Bullet::collision_response(Arena* arena) { // NOLINT
-    FazoEntity* candidates;
-    FazoQuery query {
-        .x = this->fazo_entity.x,
-        .y = this->fazo_entity.y,
-        .width = this->fazo_entity.width,
-        .height = this->fazo_entity.height,
+void Tank::send_delta_census(Arena* arena, const BroadQuery& query, const BroadEntity* candidates, size_t len) { // NOLINT
+    PooledBuffer pooled = arena->buffers.checkout();
+    StreamPeerBuffer& buf = *pooled;
+    buf.reserve(packets::DeltaCensus::min_size + len * 8);
+    buf.skip(packets::DeltaCensus::min_size); // header, patched in below
+    unsigned short entry_count = 0;
+    auto& census_snapshots = details().census_snapshots;
+
+    auto client_info = (ClientInfo*) details().client->GetUserData();
+    bool interned = client_info->has(Capability::InternedStrings);
+    vector<uint32_t>& sent_strings = details().sent_strings;
+    vector<uint32_t>& new_strings = arena->new_strings;
+    new_strings.clear();
+    auto share_string = [&](uint32_t key) {
+        uint16_t handle = StringTable::handle(key);
+        if (key == StringTable::empty) {
+            return;
+        } else if (handle >= sent_strings.size()) {
+            sent_strings.resize(handle + 1); // StringTable::empty
+        }
+        if (sent_strings[handle] != key) {
+            sent_strings[handle] = key;
+            new_strings.push_back(key);
+        }
     };
-    size_t len = FazoSolverSolve(arena->solver, &query, &candidates);
 
     for (unsigned int i = 0; i < len; i++) {
-        const FazoEntity& candidate = candidates[i];
-        unsigned int cid = candidate.id;
-        if (cid == this->id) {
+        const BroadEntity& candidate = candidates[i];
+
+        const Handle* handle = arena->handles.resolve(candidate.id);
+        if (!handle) {
+            WARN("Non-existent entity in broadphase with id " << candidate.id);
             continue;
-        } else if (cid == this->owner) {
+        } else if (handle->dying || !arena->in_view(query, *handle)) {
             continue;
-        } else if (in_map(arena->entities.bullets, cid)) {
-            if (arena->entities.bullets[cid]->owner == this->owner) {
-                continue;
-            }
         }
 
-        if (circle_collision(Vector2(candidate.x + candidate.radius, candidate.y + candidate.radius), candidate.radius, Vector2(this->position.x, this->position.y), this->radius)) {
-            if (in_map(arena->entities.bullets, cid)) {
-                this->health -= arena->entities.bullets[cid]->damage * arena->delta; // damage
-            } else if (in_map(arena->entities.shapes, cid)) {
-                this->health -= arena->entities.shapes[cid]->damage * arena->delta; // damage
+        const CensusState* state;
+        switch (handle->kind) {
+            case EntityKind::Tank: state = &arena->census_state(arena->entities.tanks.objects[handle->slot]); break;
+            case EntityKind::Shape: state = &arena->census_state(arena->entities.shapes.objects[handle->slot]); break;
+            default: state = &arena->census_state(arena->entities.bullets.objects[handle->slot]); break;
+        }
+        unsigned int cid = candidate.id;
+
+        uint16_t changed;
+        auto snapshot = census_snapshots.find(cid);
+        if (snapshot == census_snapshots.end()) {
+            changed = state->fields;
+            census_snapshots[cid] = CensusSnapshot {*state, arena->ticks};
+        } else {
+            changed = state->diff(snapshot->second.state);
+            if (changed) {
+                snapshot->second.state = *state;
             }
+            snapshot->second.tick = arena->ticks;
+        }
 
-            // response
-            float angle = atan2((candidate.y + candidate.radius) - this->position.y, (candidate.x + candidate.radius) - this->position.x);
-            Vector2 push_vec(cos(angle), sin(angle)); // heading vector
-            this->velocity.x += -push_vec.x * COLLISION_STRENGTH;
-            this->velocity.y += -push_vec.y * COLLISION_STRENGTH;
+        if (changed) {
+            packets::DeltaCensusEntry::put(buf, state->kind, cid, changed);
+            state->put(buf, changed, arena->strings, interned);
+            entry_count++;
+            if (interned) {
+                if (changed & (uint16_t) CensusField::Name) share_string(state->name);
+                if (changed & (uint16_t) CensusField::Message) share_string(state->message);
+            }
         }
     }
 
-    if (len) free(candidates);
+    // Everything the client knows about but didn't see this tick left its view
+    size_t removals_offset = buf.offset;
+    buf.skip(packets::DeltaCensusRemovals::min_size); // patched in below
+    vector<uint32_t>& removals = arena->census_removals;
+    removals.clear();
+    for (auto snapshot = census_snapshots.begin(); snapshot != census_snapshots.end();) {
+        if (snapshot->second.tick != arena->ticks) {
+            removals.push_back(snapshot->first);
+            snapshot = census_snapshots.erase(snapshot);
+        } else {
+            ++snapshot;
+        }
+    }
+    buf.put_u32_array(removals.data(), removals.size());
+    unsigned short removal_count = removals.size();
+
+    buf.offset = removals_offset;
+    packets::DeltaCensusRemovals::put(buf, removal_count);
+    buf.offset = 0;
+    packets::DeltaCensus::encode(buf, arena->size, this->level, entry_count);
+    if (!new_strings.empty()) {
+        arena->send_strings(this->details().client, new_strings);
+    }
+    arena->send_compressible(this->details().client, buf);
 }
 
+// Steering, barrels and regeneration. Arena::update moves the tank afterwards.
 void Tank::next_tick(Arena* arena) { // NOLINT
-    this->velocity.y -= this->movement_speed * (bool) this->input.W;
-    this->velocity.y += this->movement_speed * (bool) this->input.S;
-
-    this->velocity.x -= this->movement_speed * (bool) this->input.A;
-    this->velocity.x += this->movement_speed * (bool) this->input.D;
-
-    for (const auto& barrel : barrels) {
+    Vector2& velocity = this->velocity();
+    velocity.y -= this->movement_speed * (bool) this->input.W;
+    velocity.y += this->movement_speed * (bool) this->input.S;
+
+    velocity.x -= this->movement_speed * (bool) this->input.A;
+    velocity.x += this->movement_speed * (bool) this->input.D;
+
+    // Stats come from the mockup, the barrels only keep their timers
+    const vector<BarrelConfig>& configs = tanksconfig[mockup].barrels;
+    array<Barrel, MAX_BARRELS>& barrels = details().barrels;
+    for (size_t i = 0; i < configs.size(); i++) {
+        Barrel& barrel = barrels[i];
+        const BarrelConfig& config = configs[i];
         if (this->input.mousedown) {
-            if (!barrel->cooling_down) {
-                barrel->cooling_down = true;
+            if (!barrel.cooling_down) {
+                barrel.cooling_down = true;
 
-                barrel->target_time.time = arena->ticks + barrel->reload_delay / arena->avg_delta();
-                barrel->target_time.target = BarrelTarget::ReloadDelay;
+                barrel.target_time.time = arena->ticks + config.reload_delay / arena->avg_delta();
+                barrel.target_time.target = BarrelTarget::ReloadDelay;
             }
         }
-        if (barrel->target_time.target != BarrelTarget::None) {
-            if (barrel->target_time.time <= arena->ticks) {
-                switch (barrel->target_time.target) {
+        if (barrel.target_time.target != BarrelTarget::None) {
+            if (barrel.target_time.time <= arena->ticks) {
+                switch (barrel.target_time.target) {
                     case BarrelTarget::ReloadDelay: {
-                        barrel->fire(this, arena); // SAFETY: `this` and `arena` are supposedly always valid.
-                        barrel->cooling_down = true;
-                        barrel->target_time.time = arena->ticks + barrel->full_reload / arena->avg_delta();
-                        barrel->target_time.target = BarrelTarget::CoolingDown;
+                        barrel.fire(this, arena, config); // SAFETY: `this` and `arena` are supposedly always valid.
+                        barrel.cooling_down = true;
+                        barrel.target_time.time = arena->ticks + (config.full_reload - config.reload_delay) / arena->avg_delta();
+                        barrel.target_time.target = BarrelTarget::CoolingDown;
                         break;
                     }
                     case BarrelTarget::CoolingDown: {
-                        barrel->cooling_down = false;
-                        barrel->target_time.target = BarrelTarget::None;
+                        barrel.cooling_down = false;
+                        barrel.target_time.target = BarrelTarget::None;
                         break;
                     }
                     case BarrelTarget::None: break;
@@ -1276,113 +2071,14 @@ void Tank::next_tick(Arena* arena) { // NOLINT
         }
     }
 
+    float& health = this->health();
     if (health != max_health) {
         health += max_health * 0.0013;
         if (health > max_health)
             health = max_health;
     }
 
-    this->radius = 50 + (min(level, 100.f) * 0.25);
-
-    this->velocity *= Vector2(this->friction, this->friction);
-    this->position += this->velocity * Vector2(arena->delta, arena->delta) / Vector2(this->mass, this->mass);
-
-    if (this->position.x > arena->size) {
-        this->position.x = arena->size;
-        this->velocity.x = 0;
-    } else if (this->position.x < 0) {
-        this->position.x = 0;
-        this->velocity.x = 0;
-    }
-    if (this->position.y > arena->size) {
-        this->position.y = arena->size;
-        this->velocity.y = 0;
-    } else if (this->position.y < 0) {
-        this->position.y = 0;
-        this->velocity.y = 0;
-    }
-
-    this->fazo_entity.radius = this->radius;
-
-    if (this->fazo_entity.x != this->position.x - this->radius ||
-        this->fazo_entity.y != this->position.y - this->radius ||
-        this->fazo_entity.width != this->radius * 2 ||
-        this->fazo_entity.height != this->radius * 2) {
-        this->fazo_entity.x = this->position.x - this->radius;
-        this->fazo_entity.y = this->position.y - this->radius;
-        this->fazo_entity.width = this->radius * 2;
-        this->fazo_entity.height = this->radius * 2;
-
-        FazoSolverMutate(arena->solver, &this->fazo_entity);
-    }
-}
-
-void Bullet::next_tick(Arena* arena) { // NOLINT
-    this->velocity *= Vector2(this->friction, this->friction);
-    this->position += this->velocity * Vector2(arena->delta, arena->delta) / Vector2(this->mass, this->mass);
-
-    if (this->position.x > arena->size) {
-        this->position.x = arena->size;
-        this->velocity.x = 0;
-    } else if (this->position.x < 0) {
-        this->position.x = 0;
-        this->velocity.x = 0;
-    }
-    if (this->position.y > arena->size) {
-        this->position.y = arena->size;
-        this->velocity.y = 0;
-    } else if (this->position.y < 0) {
-        this->position.y = 0;
-        this->velocity.y = 0;
-    }
-
-    this->fazo_entity.radius = this->radius;
-
-    if (this->fazo_entity.x != this->position.x - this->radius ||
-        this->fazo_entity.y != this->position.y - this->radius ||
-        this->fazo_entity.width != this->radius * 2 ||
-        this->fazo_entity.height != this->radius * 2) {
-        this->fazo_entity.x = this->position.x - this->radius;
-        this->fazo_entity.y = this->position.y - this->radius;
-        this->fazo_entity.width = this->radius * 2;
-        this->fazo_entity.height = this->radius * 2;
-
-        FazoSolverMutate(arena->solver, &this->fazo_entity);
-    }
-}
-
-void Shape::next_tick(Arena* arena) { // NOLINT
-    this->velocity *= Vector2(this->friction, this->friction);
-    this->position += this->velocity * Vector2(arena->delta, arena->delta) / Vector2(this->mass, this->mass);
-
-    if (this->position.x > arena->size) {
-        this->position.x = arena->size;
-        this->velocity.x = 0;
-    } else if (this->position.x < 0) {
-        this->position.x = 0;
-        this->velocity.x = 0;
-    }
-    if (this->position.y > arena->size) {
-        this->position.y = arena->size;
-        this->velocity.y = 0;
-    } else if (this->position.y < 0) {
-        this->position.y = 0;
-        this->velocity.y = 0;
-    }
-
-    this->fazo_entity.radius = this->radius;
-
-    if (this->fazo_entity.x != this->position.x - this->radius ||
-        this->fazo_entity.y != this->position.y - this->radius ||
-        this->fazo_entity.width != this->radius * 2 ||
-        this->fazo_entity.height != this->radius * 2) {
-        this->fazo_entity.x = this->position.x - this->radius;
-        this->fazo_entity.y = this->position.y - this->radius;
-        this->fazo_entity.width = this->radius * 2;
-        this->fazo_entity.height = this->radius * 2;
-
-        FazoSolverMutate(arena->solver, &this->fazo_entity);
-    }
+    this->radius() = 50 + (min(level, 100.f) * 0.25);
 }
 
 ///////////
@@ -6,7 +6,8 @@
 #include <vector>
 
 #pragma once
-#define PI M_PI
+#define PI          M_PI
+#define MAX_BARRELS 8 // per tank, tanks keep room for this many inline
 
 using json = nlohmann::json;
 
@@ -32,6 +33,8 @@ struct TankConfig {
 
 std::vector<TankConfig> tanksconfig; // NOLINT
 
+// Replaces tanksconfig with the tanks in filename. On failure tanksconfig is
+// left as it was, so a bad edit can't take down a running server.
 int load_tanks_from_json(const std::string& filename) { // NOLINT
     std::ifstream tanks_file(filename);
     if (!tanks_file.is_open()) {
@@ -45,33 +48,40 @@ int load_tanks_from_json(const std::string& filename) { // NOLINT
     data.assign((std::istreambuf_iterator<char>(tanks_file)),
         std::istreambuf_iterator<char>());
 
-    json tanks;
+    std::vector<TankConfig> loaded;
     try {
-        tanks = json::parse(data);
+        json tanks = json::parse(data);
+        for (const auto& tank : tanks) {
+            loaded.push_back(TankConfig {
+                .name = tank.at("name"),
+                .fov = tank.at("fov")});
+            TankConfig& config = loaded.back();
+            if (tank.at("barrels").size() > MAX_BARRELS) {
+                ERR("Tank \"" << config.name << "\" in " << filename << " has more than " << MAX_BARRELS << " barrels");
+                return -1;
+            }
+            for (const auto& barrel : tank.at("barrels")) {
+                config.barrels.push_back(BarrelConfig {
+                    .angle = barrel.at("angle"),
+                    .width = barrel.at("width"),
+                    .length = barrel.at("length"),
+                    .full_reload = barrel.at("full_reload"),
+                    .reload_delay = barrel.at("reload_delay"),
+                    .recoil = barrel.at("recoil"),
+                    .bullet_speed = barrel.at("bullet_speed"),
+                    .bullet_damage = barrel.at("bullet_damage"),
+                    .bullet_penetration = barrel.at("bullet_penetration")});
+            }
+        }
     } catch (std::exception& e) {
         ERR("Failed to parse " << filename << ": " << e.what());
         return -1;
     }
-
-    for (const auto& tank : tanks) {
-        tanksconfig.push_back(TankConfig {
-            .name = tank["name"],
-            .fov = tank["fov"]});
-        int index = tanksconfig.size() - 1;
-        for (const auto& barrel : tank["barrels"]) {
-            tanksconfig[index].barrels.push_back(BarrelConfig {
-                .angle = barrel["angle"],
-                .width = barrel["width"],
-                .length = barrel["length"],
-                .full_reload = barrel["full_reload"],
-                .reload_delay = barrel["reload_delay"],
-                .recoil = barrel["recoil"],
-                .bullet_speed = barrel["bullet_speed"],
-                .bullet_damage = barrel["bullet_damage"],
-                .bullet_penetration = barrel["bullet_penetration"]});
-        }
+    if (loaded.empty()) {
+        ERR("No tanks in " << filename);
+        return -1;
     }
 
-    tanks_file.close();
+    tanksconfig = std::move(loaded);
     return 0;
 }
@@ -29,7 +29,7 @@ void kick(ws28::Client* client, bool destroy = true) {
     Arena* arena = arenas[client_info->path];
 
     if (client_info->authenticated) {
-        if (in_map(arena->entities.tanks, client_info->id)) {
+        if (arena->entities.tanks.contains(client_info->id)) {
             arena->destroy_entity(client_info->id, arena->entities.tanks);
         }
     }
@@ -65,6 +65,16 @@ int main(int argc, char** argv) {
     }
     assert(s.ok());
     assert(load_tanks_from_json("entityconfig.json") == 0);
+    if (file_exists("census.dict")) {
+        if (compressor.load_dictionary("census.dict") == 0) {
+            INFO("Loaded census compression dictionary " << compressor.dictionary_id());
+        } else {
+            ERR("Failed to load census compression dictionary");
+        }
+    }
+#ifdef RECORD_CENSUS
+    mkdir("census_samples", 0755);
+#endif
 
     uv_fs_event_t entityconfig_event_handle;
     uv_fs_event_init(uv_default_loop(), &entityconfig_event_handle);
@@ -73,16 +83,25 @@ int main(int argc, char** argv) {
         &entityconfig_event_handle, [](uv_fs_event_t* handle, const char* filename, int events, int status) {
             INFO("Hot reloading entityconfig.json");
             sync();
-            tanksconfig.clear();
-            assert(load_tanks_from_json(filename) == 0);
+            if (load_tanks_from_json(filename) != 0) {
+                ERR("Keeping the previous entityconfig.json");
+                return;
+            }
             auto arenas = (map<std::string, Arena*>*) handle->data;
-            StreamPeerBuffer buf(true);
             for (const auto& arena : *arenas) {
-                for (const auto& tank : arena.second->entities.tanks) {
-                    if (tank.second->type == TankType::Remote) {
-                        buf.reset();
-                        arena.second->send_init_packet(buf, tank.second);
-                        tank.second->define(tank.second->mockup);
+                for (Tank* tank : arena.second->entities.tanks.objects) {
+                    if (arena.second->handles.dying(tank->id)) {
+                        continue;
+                    }
+                    // Bots too, since barrel stats are read from tanksconfig
+                    if (tank->type == TankType::Remote) {
+                        arena.second->send_init_packet(*arena.second->buffers.checkout(), tank);
+                    }
+                    if (tank->mockup >= tanksconfig.size()) {
+                        WARN("Tank with id " << tank->id << " has a mockup that no longer exists, resetting it");
+                        tank->define(0);
+                    } else {
+                        tank->define(tank->mockup);
                     }
                 }
             }
@@ -109,8 +128,7 @@ int main(int argc, char** argv) {
             return;
         }
 
-        StreamPeerBuffer buf(true);
-        buf.data_array = vector<uint8_t>(data, data + len);
+        StreamPeerView buf(data, len, true);
 
         auto client_info = (ClientInfo*) client->GetUserData();
         Arena* arena = arenas[client_info->path];
@@ -121,7 +139,7 @@ int main(int argc, char** argv) {
                 break;
 
             case (int) Packet::InboundInit:
-                if (len < 3) {
+                if (!packets::InboundInit::valid_size(len)) {
                     kick(client);
                     return;
                 }
@@ -129,7 +147,7 @@ int main(int argc, char** argv) {
                 break;
 
             case (int) Packet::Input:
-                if (len != 6) {
+                if (!packets::Input::valid_size(len)) {
                     kick(client);
                     return;
                 }
@@ -137,7 +155,7 @@ int main(int argc, char** argv) {
                 break;
 
             case (int) Packet::Chat:
-                if (len < 3) {
+                if (!packets::Chat::valid_size(len)) {
                     kick(client);
                     return;
                 }
@@ -145,7 +163,7 @@ int main(int argc, char** argv) {
                 break;
 
             case (int) Packet::Respawn:
-                if (len > 1) {
+                if (!packets::Respawn::valid_size(len)) {
                     kick(client);
                     return;
                 }
@@ -166,6 +184,11 @@ int main(int argc, char** argv) {
             res.header("Content-Type", "application/json");
             res.send(server_info.dump());
             return;
+        } else if (strcmp(req.path, "/census.dict") == 0) {
+            res.header("Access-Control-Allow-Origin", "*");
+            res.header("Content-Type", "application/octet-stream");
+            res.send(compressor.dictionary);
+            return;
         } else {
             res.send("Please connect with an real client.");
             INFO("Got an http request");
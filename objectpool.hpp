@@ -0,0 +1,80 @@
+#ifndef _OBJECTPOOL_HPP
+#define _OBJECTPOOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Objects of one type carved out of fixed-size slabs and recycled through a
+// free list, so objects that come and go every tick don't go through the
+// allocator. Slabs are only given back when the pool is destroyed, by which
+// time every object must have been. Not thread-safe.
+template <typename T>
+class ObjectPool {
+public:
+    size_t slab_size;
+    size_t allocations = 0; // over the pool's lifetime
+    size_t frees = 0;
+
+    ObjectPool(size_t slab_size = 256) :
+        slab_size(slab_size) { }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    // Makes room for count live objects up front
+    void reserve(size_t count) {
+        while (capacity() < count) {
+            add_slab();
+        }
+    }
+
+    template <typename... Args>
+    T* create(Args&&... args) {
+        if (free_list.empty()) {
+            add_slab();
+        }
+        T* object = free_list.back();
+        free_list.pop_back();
+        allocations++;
+        return new (object) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T* object) {
+        object->~T();
+        free_list.push_back(object);
+        frees++;
+    }
+
+    size_t live() const {
+        return allocations - frees;
+    }
+
+    size_t capacity() const {
+        return slabs.size() * slab_size;
+    }
+
+    size_t slab_count() const {
+        return slabs.size();
+    }
+
+private:
+    using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+    std::vector<std::unique_ptr<Storage[]>> slabs;
+    std::vector<T*> free_list;
+
+    void add_slab() {
+        slabs.emplace_back(new Storage[slab_size]);
+        Storage* slab = slabs.back().get();
+        // Backwards, so the slab is handed out front to back
+        for (size_t i = slab_size; i-- > 0;) {
+            free_list.push_back(reinterpret_cast<T*>(&slab[i]));
+        }
+    }
+};
+
+#endif
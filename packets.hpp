@@ -0,0 +1,359 @@
+#ifndef _PACKETS_HPP
+#define _PACKETS_HPP
+
+#include "streampeerbuffer.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+enum class Packet : unsigned char {
+    InboundInit = 0,
+    Input = 1,
+    Census = 2,
+    OutboundInit = 3,
+    Mockups = 3,
+    Chat = 4,
+    Death = 5,
+    Respawn = 6,
+    Leaderboard = 7,
+    DeltaCensus = 8,
+    Compressed = 9,
+    Strings = 10
+};
+
+// Flags a client may append to its init packet to opt into newer protocol
+// features. Clients that send none get the original protocol.
+enum class Capability : uint8_t {
+    DeltaCensus = 1 << 0,
+    Compression = 1 << 1,
+    InternedStrings = 1 << 2 // delta census strings as handles, see packets::Strings
+};
+
+// Fields of a delta census entry, in the order they are written
+enum class CensusField : uint16_t {
+    Position = 1 << 0, // i16 x, i16 y
+    Velocity = 1 << 1, // i16 x, i16 y
+    Rotation = 1 << 2, // f32
+    Health = 1 << 3,   // f32
+    Radius = 1 << 4,   // u16
+    Mockup = 1 << 5,   // u8
+    Name = 1 << 6,     // string, or u16 string handle
+    Message = 1 << 7,  // string, or u16 string handle
+    Owner = 1 << 8     // u32
+};
+
+// Wire layouts, declared once. Each field type knows its encoded size (the
+// minimum size for variable-length fields), so a layout knows at compile time
+// whether it is fixed-size and how many bytes it needs at least.
+namespace packets {
+    template <typename T, size_t Size>
+    struct Number {
+        using type = T;
+        static constexpr size_t size = Size;
+        static constexpr bool fixed = true;
+
+        static size_t size_of(const type&) {
+            return size;
+        }
+
+        static void store(uint8_t*& dst, const type& value, bool swap) {
+            spb::write_number(dst, value, swap);
+            dst += size;
+        }
+    };
+
+    struct U8: Number<uint8_t, 1> {
+        template <typename Reader>
+        static bool get(Reader& buf, type& value) {
+            value = buf.get_u8();
+            return true;
+        }
+    };
+
+    struct U16: Number<uint16_t, 2> {
+        template <typename Reader>
+        static bool get(Reader& buf, type& value) {
+            value = buf.get_u16();
+            return true;
+        }
+
+        template <typename Reader>
+        static void get_array(Reader& buf, type* values, size_t count) {
+            buf.get_u16_array(values, count);
+        }
+    };
+
+    struct U32: Number<uint32_t, 4> {
+        template <typename Reader>
+        static bool get(Reader& buf, type& value) {
+            value = buf.get_u32();
+            return true;
+        }
+
+        template <typename Reader>
+        static void get_array(Reader& buf, type* values, size_t count) {
+            buf.get_u32_array(values, count);
+        }
+    };
+
+    struct I16: Number<int16_t, 2> {
+        template <typename Reader>
+        static bool get(Reader& buf, type& value) {
+            value = buf.get_i16();
+            return true;
+        }
+
+        template <typename Reader>
+        static void get_array(Reader& buf, type* values, size_t count) {
+            buf.get_i16_array(values, count);
+        }
+    };
+
+    struct F32: Number<float, 4> {
+        template <typename Reader>
+        static bool get(Reader& buf, type& value) {
+            value = buf.get_float();
+            return true;
+        }
+
+        template <typename Reader>
+        static void get_array(Reader& buf, type* values, size_t count) {
+            buf.get_float_array(values, count);
+        }
+    };
+
+    struct F64: Number<double, 8> {
+        template <typename Reader>
+        static bool get(Reader& buf, type& value) {
+            value = buf.get_double();
+            return true;
+        }
+    };
+
+    // Two numbers of one type side by side, such as a position, stored and
+    // read as one array
+    template <typename Field>
+    struct Pair {
+        using type = std::array<typename Field::type, 2>;
+        static constexpr size_t size = Field::size * 2;
+        static constexpr bool fixed = true;
+
+        static size_t size_of(const type&) {
+            return size;
+        }
+
+        static void store(uint8_t*& dst, const type& value, bool swap) {
+            spb::write_numbers(dst, value.data(), value.size(), swap);
+            dst += size;
+        }
+
+        template <typename Reader>
+        static bool get(Reader& buf, type& value) {
+            Field::get_array(buf, value.data(), value.size());
+            return true;
+        }
+    };
+
+    using I16Pair = Pair<I16>;
+
+    // u16 length followed by the bytes
+    struct Str {
+        using type = std::string;
+        static constexpr size_t size = 2;
+        static constexpr bool fixed = false;
+
+        static size_t size_of(const type& value) {
+            return size + value.size();
+        }
+
+        static void store(uint8_t*& dst, const type& value, bool swap) {
+            spb::write_number<uint16_t>(dst, value.size(), swap);
+            memcpy(dst + size, value.data(), value.size());
+            dst += size + value.size();
+        }
+        template <typename Reader>
+        static bool get(Reader& buf, type& value) {
+            return buf.get_string(value) == 0;
+        }
+    };
+
+    // A string that is cut to MaxLength bytes as it's decoded, before anything
+    // past that is copied
+    template <size_t MaxLength>
+    struct BoundedStr: Str {
+        template <typename Reader>
+        static bool get(Reader& buf, type& value) {
+            return buf.get_string(value, MaxLength) == 0;
+        }
+    };
+
+    // A sequence of fields without a packet id, for records repeated inside a
+    // packet (census entries, leaderboard rows, mockups).
+    template <typename... Fields>
+    struct Record;
+
+    template <>
+    struct Record<> {
+        static constexpr size_t min_size = 0;
+        static constexpr bool fixed = true;
+
+        static size_t size_of() {
+            return 0;
+        }
+
+        static void store(uint8_t*&, bool) { }
+
+        template <typename Reader>
+        static bool get(Reader&) {
+            return true;
+        }
+    };
+
+    template <typename Field, typename... Fields>
+    struct Record<Field, Fields...> {
+        using Rest = Record<Fields...>;
+        static constexpr size_t min_size = Field::size + Rest::min_size;
+        static constexpr bool fixed = Field::fixed && Rest::fixed;
+
+        static size_t size_of(const typename Field::type& value, const typename Fields::type&... values) {
+            return Field::size_of(value) + Rest::size_of(values...);
+        }
+
+        // Claims the record's bytes in one go, then stores every field
+        // straight into them
+        static void put(spb::StreamPeerBuffer& buf, const typename Field::type& value, const typename Fields::type&... values) {
+            uint8_t* dst = buf.skip(size_of(value, values...));
+            store(dst, buf.big_endian, value, values...);
+        }
+
+        static void store(uint8_t*& dst, bool swap, const typename Field::type& value, const typename Fields::type&... values) {
+            Field::store(dst, value, swap);
+            Rest::store(dst, swap, values...);
+        }
+
+        template <typename Reader>
+        static bool get(Reader& buf, typename Field::type& value, typename Fields::type&... values) {
+            return Field::get(buf, value) && Rest::get(buf, values...);
+        }
+    };
+
+    // A whole packet: the packet id followed by Fields. Repeated records, if
+    // any, follow the fields and are written by the caller.
+    template <Packet ID, typename... Fields>
+    struct Schema {
+        using Body = Record<Fields...>;
+        static constexpr Packet id = ID;
+        static constexpr size_t min_size = 1 + Body::min_size;
+        static constexpr bool fixed = Body::fixed;
+
+        // Checks an inbound frame's length (including the id) in one go
+        static bool valid_size(size_t len) {
+            return fixed ? len == min_size : len >= min_size;
+        }
+
+        static size_t size_of(const typename Fields::type&... values) {
+            return 1 + Body::size_of(values...);
+        }
+
+        static void encode(spb::StreamPeerBuffer& buf, const typename Fields::type&... values) {
+            uint8_t* dst = buf.skip(size_of(values...));
+            *dst++ = (uint8_t) ID;
+            Body::store(dst, buf.big_endian, values...);
+        }
+
+        // Expects the packet id to have been consumed already
+        template <typename Reader>
+        static bool decode(Reader& buf, typename Fields::type&... values) {
+            return Body::get(buf, values...);
+        }
+    };
+
+    // Inbound
+    using InboundInit = Schema<Packet::InboundInit, BoundedStr<14>>; // name
+    using InboundInitCapabilities = Record<U8>;                      // optional capability flags
+    using Input = Schema<Packet::Input,
+        U8,       // movement & mouse buttons
+        I16Pair>; // mouse position
+    using Chat = Schema<Packet::Chat, BoundedStr<100>>; // message
+    using Respawn = Schema<Packet::Respawn>;
+
+    // Outbound
+    using OutboundInit = Schema<Packet::OutboundInit,
+        U32, // player id
+        U8>; // amount of mockups
+    using Mockup = Record<
+        Str, // name
+        U8,  // fov
+        U8>; // amount of barrels
+    using MockupBarrel = Record<
+        F32,  // width
+        F32,  // length
+        F32>; // angle
+
+    using Census = Schema<Packet::Census,
+        U16,  // amount of entities
+        U16,  // arena size
+        F32>; // level
+    using TankCensus = Record<
+        U8,   // id (0)
+        U32,  // game id
+        I16Pair, // position
+        F32,     // rotation
+        I16Pair, // velocity
+        U8,      // mockup id
+        F32,     // health
+        U16,     // radius
+        Str,     // tank name
+        Str>;    // chat message
+    using ShapeCensus = Record<
+        U8,   // id (1)
+        U32,  // game id
+        I16Pair, // position
+        F32,     // health
+        U16>;    // radius
+    using BulletCensus = Record<
+        U8,   // id (2)
+        U32,  // game id
+        I16Pair, // position
+        U16,     // radius
+        I16Pair, // velocity
+        U32>;    // owner of bullet
+
+    // Only what changed since the previous census sent to the same client.
+    // Entities that have not changed are left out, and entities that left
+    // the view are listed after the entries.
+    using DeltaCensus = Schema<Packet::DeltaCensus,
+        U16,  // arena size
+        F32,  // level
+        U16>; // amount of entries
+    using DeltaCensusEntry = Record<
+        U8,   // id (0 tank, 1 shape, 2 bullet)
+        U32,  // game id
+        U16>; // changed fields, followed by each field set
+    using DeltaCensusRemovals = Record<U16>; // amount of game ids, followed by each u32
+
+    // Strings that delta censuses refer to by handle, for clients with
+    // Capability::InternedStrings. Sent before the first census that uses
+    // them. A handle stands for its string until it's sent again with
+    // another one, and handle 0 is always the empty string.
+    using Strings = Schema<Packet::Strings, U16>; // amount of strings
+    using StringEntry = Record<
+        U16,  // handle
+        Str>; // string
+
+    using Death = Schema<Packet::Death, F64>; // seconds elapsed since spawn
+
+    // Followed by a zstd frame holding another packet, id included. Frames are
+    // made with the dictionary served at /census.dict when it has one.
+    using Compressed = Schema<Packet::Compressed>;
+
+    using Leaderboard = Schema<Packet::Leaderboard, U8>; // amount of entries
+    using LeaderboardEntry = Record<
+        Str,  // name
+        F32,  // level
+        U8>;  // mockup id
+} // namespace packets
+
+#endif
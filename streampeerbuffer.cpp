@@ -1,5 +1,5 @@
 #include "streampeerbuffer.hpp"
-#include <array>
+#include <algorithm>
 #include <string.h>
 #include <string>
 #include <vector>
@@ -18,228 +18,193 @@ namespace spb {
         this->big_endian = big_endian;
     }
 
+    template <typename T>
+    void StreamPeerBuffer::put_number(T number) {
+        write_number(skip(sizeof(T)), number, big_endian);
+    }
+
+    template <typename T>
+    T StreamPeerBuffer::get_number() {
+        T number = read_number<T>(data_array.data() + offset, big_endian);
+        offset += sizeof(T);
+        return number;
+    }
+
+    template <typename T>
+    void StreamPeerBuffer::put_numbers(const T* numbers, size_t count) {
+        write_numbers(skip(count * sizeof(T)), numbers, count, big_endian);
+    }
+
+    template <typename T>
+    void StreamPeerBuffer::get_numbers(T* numbers, size_t count) {
+        read_numbers(data_array.data() + offset, numbers, count, big_endian);
+        offset += count * sizeof(T);
+    }
+
     void StreamPeerBuffer::put_u8(uint8_t number) {
-        data_array.insert(data_array.begin() + offset, number);
-        offset++;
+        put_number(number);
     }
 
     void StreamPeerBuffer::put_u16(uint16_t number) {
-        if (big_endian) {
-            number = bswap(number);
-        }
-        const auto bytes = to_bytes(number);
-        data_array.insert(data_array.begin() + offset, bytes.begin(), bytes.end());
-        offset += 2;
+        put_number(number);
     }
 
     void StreamPeerBuffer::put_u32(uint32_t number) {
-        if (big_endian) {
-            number = bswap(number);
-        }
-        const auto bytes = to_bytes(number);
-        data_array.insert(data_array.begin() + offset, bytes.begin(), bytes.end());
-        offset += 4;
+        put_number(number);
     }
 
     void StreamPeerBuffer::put_u64(uint64_t number) {
-        if (big_endian) {
-            number = bswap(number);
-        }
-        const auto bytes = to_bytes(number);
-        data_array.insert(data_array.begin() + offset, bytes.begin(), bytes.end());
-        offset += 8;
+        put_number(number);
     }
 
     void StreamPeerBuffer::put_i8(int8_t number) {
-        data_array.insert(data_array.begin() + offset, number);
-        offset++;
+        put_number(number);
     }
 
     void StreamPeerBuffer::put_i16(int16_t number) {
-        if (big_endian) {
-            number = bswap(number);
-        }
-        const auto bytes = to_bytes(number);
-        data_array.insert(data_array.begin() + offset, bytes.begin(), bytes.end());
-        offset += 2;
+        put_number(number);
     }
 
     void StreamPeerBuffer::put_i32(int32_t number) {
-        if (big_endian) {
-            number = bswap(number);
-        }
-        const auto bytes = to_bytes(number);
-        data_array.insert(data_array.begin() + offset, bytes.begin(), bytes.end());
-        offset += 4;
+        put_number(number);
     }
 
     void StreamPeerBuffer::put_i64(int64_t number) {
-        if (big_endian) {
-            number = bswap(number);
-        }
-        const auto bytes = to_bytes(number);
-        data_array.insert(data_array.begin() + offset, bytes.begin(), bytes.end());
-        offset += 8;
+        put_number(number);
     }
 
     uint8_t StreamPeerBuffer::get_u8() {
-        uint8_t number;
-        from_bytes({data_array[offset]}, number);
-        offset++;
-        return number;
+        return get_number<uint8_t>();
     }
 
     uint16_t StreamPeerBuffer::get_u16() {
-        uint16_t number;
-        from_bytes({data_array[offset], data_array[offset + 1]}, number);
-        offset += 2;
-        if (big_endian) {
-            number = bswap(number);
-        }
-        return number;
+        return get_number<uint16_t>();
     }
 
     uint32_t StreamPeerBuffer::get_u32() {
-        uint32_t number;
-        from_bytes({data_array[offset], data_array[offset + 1], data_array[offset + 2], data_array[offset + 3]}, number);
-        offset += 4;
-        if (big_endian) {
-            number = bswap(number);
-        }
-        return number;
+        return get_number<uint32_t>();
     }
 
     uint64_t StreamPeerBuffer::get_u64() {
-        uint64_t number;
-        from_bytes({
-                       data_array[offset],
-                       data_array[offset + 1],
-                       data_array[offset + 2],
-                       data_array[offset + 3],
-                       data_array[offset + 4],
-                       data_array[offset + 5],
-                       data_array[offset + 6],
-                       data_array[offset + 7],
-                   },
-            number);
-        offset += 8;
-        if (big_endian) {
-            number = bswap(number);
-        }
-        return number;
+        return get_number<uint64_t>();
     }
 
     int8_t StreamPeerBuffer::get_i8() {
-        int8_t number;
-        from_bytes({data_array[offset]}, number);
-        offset++;
-        return number;
+        return get_number<int8_t>();
     }
 
     int16_t StreamPeerBuffer::get_i16() {
-        int16_t number;
-        from_bytes({data_array[offset], data_array[offset + 1]}, number);
-        offset += 2;
-        if (big_endian) {
-            number = bswap(number);
-        }
-        return number;
+        return get_number<int16_t>();
     }
 
     int32_t StreamPeerBuffer::get_i32() {
-        int32_t number;
-        from_bytes({data_array[offset], data_array[offset + 1], data_array[offset + 2], data_array[offset + 3]}, number);
-        offset += 4;
-        if (big_endian) {
-            number = bswap(number);
-        }
-        return number;
+        return get_number<int32_t>();
     }
 
     int64_t StreamPeerBuffer::get_i64() {
-        int64_t number;
-        from_bytes({
-                       data_array[offset],
-                       data_array[offset + 1],
-                       data_array[offset + 2],
-                       data_array[offset + 3],
-                       data_array[offset + 4],
-                       data_array[offset + 5],
-                       data_array[offset + 6],
-                       data_array[offset + 7],
-                   },
-            number);
-        offset += 8;
-        if (big_endian) {
-            number = bswap(number);
-        }
-        return number;
+        return get_number<int64_t>();
+    }
+
+    void StreamPeerBuffer::put_u16_array(const uint16_t* numbers, size_t count) {
+        put_numbers(numbers, count);
+    }
+
+    void StreamPeerBuffer::put_u32_array(const uint32_t* numbers, size_t count) {
+        put_numbers(numbers, count);
+    }
+
+    void StreamPeerBuffer::put_i16_array(const int16_t* numbers, size_t count) {
+        put_numbers(numbers, count);
+    }
+
+    void StreamPeerBuffer::put_float_array(const float* numbers, size_t count) {
+        put_numbers(numbers, count);
+    }
+
+    void StreamPeerBuffer::get_u16_array(uint16_t* numbers, size_t count) {
+        get_numbers(numbers, count);
+    }
+
+    void StreamPeerBuffer::get_u32_array(uint32_t* numbers, size_t count) {
+        get_numbers(numbers, count);
+    }
+
+    void StreamPeerBuffer::get_i16_array(int16_t* numbers, size_t count) {
+        get_numbers(numbers, count);
+    }
+
+    void StreamPeerBuffer::get_float_array(float* numbers, size_t count) {
+        get_numbers(numbers, count);
     }
 
     void StreamPeerBuffer::put_string(const std::string& str) {
         put_u16(str.length());
-        data_array.insert(data_array.begin() + offset, str.begin(), str.end());
-        offset += str.length();
+        put_data((const uint8_t*) str.data(), str.length());
+    }
+
+    // Strings longer than max_length are cut short; the rest is skipped
+    // without being copied
+    int StreamPeerBuffer::get_string(std::string& str, size_t max_length) {
+        StringView view;
+        if (get_string_view(view) != 0)
+            return 1;
+        str.assign(view.data, std::min(view.size, max_length));
+        return 0;
     }
 
-    int StreamPeerBuffer::get_string(std::string& str) {
+    int StreamPeerBuffer::get_string_view(StringView& view) {
         uint16_t length = get_u16();
         if (length > size() - offset)
             return 1;
-        std::vector<int8_t> bytes;
-        for (uint16_t b = 0; b < length; b++)
-            bytes.push_back(get_i8());
-        str.resize(length);
-        std::copy(bytes.begin(), bytes.end(), str.begin());
+        view.data = (const char*) data_array.data() + offset;
+        view.size = length;
+        offset += length;
         return 0;
     }
 
     void StreamPeerBuffer::put_float(float number) {
-        if (big_endian) {
-            number = bswap(number);
-        }
-        const auto bytes = to_bytes(number);
-        data_array.insert(data_array.begin() + offset, bytes.begin(), bytes.end());
-        offset += 4;
+        put_number(number);
     }
 
     float StreamPeerBuffer::get_float() {
-        float number;
-        from_bytes({data_array[offset], data_array[offset + 1], data_array[offset + 2], data_array[offset + 3]}, number);
-        offset += 4;
-        if (big_endian) {
-            number = bswap(number);
-        }
-        return number;
+        return get_number<float>();
     }
 
     void StreamPeerBuffer::put_double(double number) {
-        if (big_endian) {
-            number = bswap(number);
-        }
-        const auto bytes = to_bytes(number);
-        data_array.insert(data_array.begin() + offset, bytes.begin(), bytes.end());
-        offset += 8;
+        put_number(number);
     }
 
     double StreamPeerBuffer::get_double() {
-        double number;
-        from_bytes({
-                       data_array[offset],
-                       data_array[offset + 1],
-                       data_array[offset + 2],
-                       data_array[offset + 3],
-                       data_array[offset + 4],
-                       data_array[offset + 5],
-                       data_array[offset + 6],
-                       data_array[offset + 7],
-                   },
-            number);
-        offset += 8;
-        if (big_endian) {
-            number = bswap(number);
+        return get_number<double>();
+    }
+
+    void StreamPeerBuffer::put_data(const uint8_t* bytes, size_t length) {
+        if (length == 0) {
+            return;
         }
-        return number;
+        if (offset > data_array.size()) {
+            data_array.resize(offset);
+        }
+        // Overwrite whatever is already at offset, then append the rest
+        size_t overlap = std::min(length, data_array.size() - offset);
+        if (overlap) {
+            memcpy(data_array.data() + offset, bytes, overlap);
+        }
+        data_array.insert(data_array.end(), bytes + overlap, bytes + length);
+        offset += length;
+    }
+
+    uint8_t* StreamPeerBuffer::skip(size_t length) {
+        if (offset + length > data_array.size()) {
+            data_array.resize(offset + length);
+        }
+        uint8_t* skipped = data_array.data() + offset;
+        offset += length;
+        return skipped;
+    }
+
+    void StreamPeerBuffer::reserve(size_t capacity) {
+        data_array.reserve(capacity);
     }
 
     void StreamPeerBuffer::reset() {
@@ -258,4 +223,162 @@ namespace spb {
     void StreamPeerBuffer::resize(size_t size) {
         data_array.resize(size);
     }
+
+    StreamPeerView::StreamPeerView(const char* data, size_t length, bool big_endian) :
+        data_ptr((const uint8_t*) data),
+        length(length) {
+#if __has_include(<endian.h>)
+    #if __BYTE_ORDER == __BIG_ENDIAN
+        big_endian = !big_endian;
+    #endif
+#endif
+        this->big_endian = big_endian;
+    }
+
+    template <typename T>
+    T StreamPeerView::get_number() {
+        if (offset + sizeof(T) > length) {
+            offset = length;
+            overflowed = true;
+            return T();
+        }
+        T number = read_number<T>(data_ptr + offset, big_endian);
+        offset += sizeof(T);
+        return number;
+    }
+
+    template <typename T>
+    void StreamPeerView::get_numbers(T* numbers, size_t count) {
+        if (count > (length - offset) / sizeof(T)) {
+            offset = length;
+            overflowed = true;
+            std::fill(numbers, numbers + count, T());
+            return;
+        }
+        read_numbers(data_ptr + offset, numbers, count, big_endian);
+        offset += count * sizeof(T);
+    }
+
+    uint8_t StreamPeerView::get_u8() {
+        return get_number<uint8_t>();
+    }
+
+    uint16_t StreamPeerView::get_u16() {
+        return get_number<uint16_t>();
+    }
+
+    uint32_t StreamPeerView::get_u32() {
+        return get_number<uint32_t>();
+    }
+
+    uint64_t StreamPeerView::get_u64() {
+        return get_number<uint64_t>();
+    }
+
+    int8_t StreamPeerView::get_i8() {
+        return get_number<int8_t>();
+    }
+
+    int16_t StreamPeerView::get_i16() {
+        return get_number<int16_t>();
+    }
+
+    int32_t StreamPeerView::get_i32() {
+        return get_number<int32_t>();
+    }
+
+    int64_t StreamPeerView::get_i64() {
+        return get_number<int64_t>();
+    }
+
+    // Strings longer than max_length are cut short; the rest is skipped
+    // without being copied
+    int StreamPeerView::get_string(std::string& str, size_t max_length) {
+        StringView view;
+        if (get_string_view(view) != 0)
+            return 1;
+        str.assign(view.data, std::min(view.size, max_length));
+        return 0;
+    }
+
+    int StreamPeerView::get_string_view(StringView& view) {
+        uint16_t length = get_u16();
+        if (overflowed || length > size() - offset)
+            return 1;
+        view.data = (const char*) data_ptr + offset;
+        view.size = length;
+        offset += length;
+        return 0;
+    }
+
+    float StreamPeerView::get_float() {
+        return get_number<float>();
+    }
+
+    double StreamPeerView::get_double() {
+        return get_number<double>();
+    }
+
+    void StreamPeerView::get_u16_array(uint16_t* numbers, size_t count) {
+        get_numbers(numbers, count);
+    }
+
+    void StreamPeerView::get_u32_array(uint32_t* numbers, size_t count) {
+        get_numbers(numbers, count);
+    }
+
+    void StreamPeerView::get_i16_array(int16_t* numbers, size_t count) {
+        get_numbers(numbers, count);
+    }
+
+    void StreamPeerView::get_float_array(float* numbers, size_t count) {
+        get_numbers(numbers, count);
+    }
+
+    size_t StreamPeerView::size() {
+        return length;
+    }
+
+    const uint8_t* StreamPeerView::data() {
+        return data_ptr;
+    }
+
+    PooledBuffer::PooledBuffer(StreamPeerBufferPool* pool, std::unique_ptr<StreamPeerBuffer> buf) :
+        pool(pool),
+        buf(std::move(buf)) { }
+
+    PooledBuffer::~PooledBuffer() {
+        if (buf) {
+            pool->give_back(std::move(buf));
+        }
+    }
+
+    StreamPeerBuffer& PooledBuffer::operator*() {
+        return *buf;
+    }
+
+    StreamPeerBuffer* PooledBuffer::operator->() {
+        return buf.get();
+    }
+
+    StreamPeerBufferPool::StreamPeerBufferPool(bool big_endian) :
+        big_endian(big_endian) { }
+
+    PooledBuffer StreamPeerBufferPool::checkout() {
+        if (buffers.empty()) {
+            return PooledBuffer(this, std::unique_ptr<StreamPeerBuffer>(new StreamPeerBuffer(big_endian)));
+        }
+        std::unique_ptr<StreamPeerBuffer> buf = std::move(buffers.back());
+        buffers.pop_back();
+        buf->reset();
+        return PooledBuffer(this, std::move(buf));
+    }
+
+    void StreamPeerBufferPool::give_back(std::unique_ptr<StreamPeerBuffer> buf) {
+        buffers.push_back(std::move(buf));
+    }
+
+    size_t StreamPeerBufferPool::size() {
+        return buffers.size();
+    }
 } // namespace spb
@@ -4,6 +4,7 @@
 #include <array>
 #include <cstdint>
 #include <cstring>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -11,40 +12,117 @@ namespace spb {
     template <typename T>
     std::array<uint8_t, sizeof(T)> to_bytes(const T& object) {
         std::array<uint8_t, sizeof(T)> bytes;
-        union {
-            T object;
-            uint8_t bytes[sizeof(T)];
-        } converter;
-        converter.object = object;
-        std::copy(std::begin(converter.bytes), std::end(converter.bytes), std::begin(bytes));
+        memcpy(bytes.data(), &object, sizeof(T));
         return bytes;
     }
 
     template <typename T>
     void from_bytes(const std::array<uint8_t, sizeof(T)>& bytes,
         T& object) {
-        union {
-            T object;
-            uint8_t bytes[sizeof(T)];
-        } converter;
-        memcpy(converter.bytes, bytes.data(), sizeof(T));
-        object = converter.object;
+        memcpy(&object, bytes.data(), sizeof(T));
     }
 
+    inline uint8_t bswap_bits(uint8_t bits) {
+        return bits;
+    }
+
+    inline uint16_t bswap_bits(uint16_t bits) {
+        return __builtin_bswap16(bits);
+    }
+
+    inline uint32_t bswap_bits(uint32_t bits) {
+        return __builtin_bswap32(bits);
+    }
+
+    inline uint64_t bswap_bits(uint64_t bits) {
+        return __builtin_bswap64(bits);
+    }
+
+    // Unsigned integer with the same size as a field, for swapping bytes of
+    // floats without ever holding the swapped value in a float
+    template <size_t Size>
+    struct Bits;
+    template <>
+    struct Bits<1> { using type = uint8_t; };
+    template <>
+    struct Bits<2> { using type = uint16_t; };
+    template <>
+    struct Bits<4> { using type = uint32_t; };
+    template <>
+    struct Bits<8> { using type = uint64_t; };
+
     template <typename T>
     T bswap(T val) {
-        T ret;
-        auto pointer_val = (int8_t*) &val;
-        auto pointer_ret = (int8_t*) &ret;
-        size_t size = sizeof(T);
+        typename Bits<sizeof(T)>::type bits;
+        memcpy(&bits, &val, sizeof(T));
+        bits = bswap_bits(bits);
+        memcpy(&val, &bits, sizeof(T));
+        return val;
+    }
 
-        for (size_t i = 0; i < size; i++) {
-            pointer_ret[size - 1 - i] = pointer_val[i];
+    template <typename T>
+    inline void write_number(uint8_t* dst, T number, bool swap) {
+        typename Bits<sizeof(T)>::type bits;
+        memcpy(&bits, &number, sizeof(T));
+        if (swap) {
+            bits = bswap_bits(bits);
         }
+        memcpy(dst, &bits, sizeof(T));
+    }
 
-        return ret;
+    template <typename T>
+    inline T read_number(const uint8_t* src, bool swap) {
+        typename Bits<sizeof(T)>::type bits;
+        memcpy(&bits, src, sizeof(T));
+        if (swap) {
+            bits = bswap_bits(bits);
+        }
+        T number;
+        memcpy(&number, &bits, sizeof(T));
+        return number;
     }
 
+    // Written as plain loops over memcpy and __builtin_bswap so the compiler
+    // turns them into vector shuffles
+    template <typename T>
+    inline void write_numbers(uint8_t* dst, const T* numbers, size_t count, bool swap) {
+        if (!swap) {
+            memcpy(dst, numbers, count * sizeof(T));
+            return;
+        }
+        for (size_t i = 0; i < count; i++) {
+            write_number(dst + i * sizeof(T), numbers[i], true);
+        }
+    }
+
+    template <typename T>
+    inline void read_numbers(const uint8_t* src, T* numbers, size_t count, bool swap) {
+        if (!swap) {
+            memcpy(numbers, src, count * sizeof(T));
+            return;
+        }
+        for (size_t i = 0; i < count; i++) {
+            numbers[i] = read_number<T>(src + i * sizeof(T), true);
+        }
+    }
+
+    // Non-owning string pointing into a buffer's memory, valid for as long as
+    // that memory is
+    struct StringView {
+        const char* data = nullptr;
+        size_t size = 0;
+    };
+
+    // A piece of an outbound packet living in someone else's memory, so a
+    // packet can be assembled from shared pieces without copying them first
+    struct Segment {
+        const uint8_t* data;
+        size_t size;
+    };
+
+    // Writes overwrite the bytes at offset and append past the end, so a
+    // header can be reserved with skip() and patched in once the body is
+    // known without moving the body.
     class StreamPeerBuffer {
     public:
         std::vector<uint8_t> data_array;
@@ -73,18 +151,123 @@ namespace spb {
         int32_t get_i32();
         int64_t get_i64();
 
+        void put_u16_array(const uint16_t*, size_t);
+        void put_u32_array(const uint32_t*, size_t);
+        void put_i16_array(const int16_t*, size_t);
+        void put_float_array(const float*, size_t);
+
+        void get_u16_array(uint16_t*, size_t);
+        void get_u32_array(uint32_t*, size_t);
+        void get_i16_array(int16_t*, size_t);
+        void get_float_array(float*, size_t);
+
         void put_string(const std::string&);
-        int get_string(std::string& str);
+        int get_string(std::string& str, size_t max_length = UINT16_MAX);
+        int get_string_view(StringView& view);
+
+        void put_data(const uint8_t*, size_t);
+        uint8_t* skip(size_t);
 
         void put_float(float);
         float get_float();
         void put_double(double);
         double get_double();
 
+        void reserve(size_t);
         void reset();
         size_t size();
         uint8_t* data();
         void resize(size_t);
+
+    private:
+        template <typename T>
+        void put_number(T);
+        template <typename T>
+        T get_number();
+        template <typename T>
+        void put_numbers(const T*, size_t);
+        template <typename T>
+        void get_numbers(T*, size_t);
+    };
+
+    // Read-only view over memory owned by someone else, such as an inbound
+    // frame. Reading past the end yields zeroes and sets overflowed instead of
+    // touching memory outside the view.
+    class StreamPeerView {
+    public:
+        const uint8_t* data_ptr;
+        size_t length;
+        size_t offset = 0;
+        bool big_endian = false;
+        bool overflowed = false;
+
+        StreamPeerView(const char* data, size_t length, bool big_endian = true);
+
+        uint8_t get_u8();
+        uint16_t get_u16();
+        uint32_t get_u32();
+        uint64_t get_u64();
+
+        int8_t get_i8();
+        int16_t get_i16();
+        int32_t get_i32();
+        int64_t get_i64();
+
+        int get_string(std::string& str, size_t max_length = UINT16_MAX);
+        int get_string_view(StringView& view);
+
+        float get_float();
+        double get_double();
+
+        void get_u16_array(uint16_t*, size_t);
+        void get_u32_array(uint32_t*, size_t);
+        void get_i16_array(int16_t*, size_t);
+        void get_float_array(float*, size_t);
+
+        size_t size();
+        const uint8_t* data();
+
+    private:
+        template <typename T>
+        T get_number();
+        template <typename T>
+        void get_numbers(T*, size_t);
+    };
+
+    class StreamPeerBufferPool;
+
+    // A buffer checked out of a StreamPeerBufferPool. It goes back to the pool
+    // when this goes out of scope, so it must not be used after that.
+    class PooledBuffer {
+    public:
+        PooledBuffer(StreamPeerBufferPool* pool, std::unique_ptr<StreamPeerBuffer> buf);
+        PooledBuffer(PooledBuffer&&) = default;
+        PooledBuffer& operator=(PooledBuffer&&) = delete;
+        ~PooledBuffer();
+
+        StreamPeerBuffer& operator*();
+        StreamPeerBuffer* operator->();
+
+    private:
+        StreamPeerBufferPool* pool;
+        std::unique_ptr<StreamPeerBuffer> buf;
+    };
+
+    // Buffers that keep their capacity between uses, so building a packet
+    // doesn't regrow a vector from nothing every time. Not thread-safe.
+    class StreamPeerBufferPool {
+    public:
+        bool big_endian;
+
+        StreamPeerBufferPool(bool big_endian = true);
+
+        // Hands out an empty buffer
+        PooledBuffer checkout();
+        void give_back(std::unique_ptr<StreamPeerBuffer> buf);
+        size_t size();
+
+    private:
+        std::vector<std::unique_ptr<StreamPeerBuffer>> buffers;
     };
 } // namespace spb
 